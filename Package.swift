@@ -38,6 +38,9 @@ let package = Package(
 				.define("USE_NSOBJECT_PARSING", to: "1"),
 				.define("USE_TRAVELKIT_FOUNDATION", to: "1"),
 				.define("USE_TRAVELKIT_AS_SPM_PACKAGE", to: "1"),
+			],
+			linkerSettings: [
+				.linkedLibrary("z"),
 			]
 		),
 	]
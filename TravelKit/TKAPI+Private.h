@@ -20,6 +20,8 @@
 #import <TravelKit/TKToursQuery.h>
 #import <TravelKit/TKDirectionsManager.h>
 
+@class TKPlacesStore;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -72,6 +74,13 @@ typedef NS_ENUM(NSUInteger, TKAPIRequestState)
 	TKAPIRequestStateFinished,
 };
 
+typedef NS_ENUM(NSUInteger, TKAPIRequestPriority)
+{
+	TKAPIRequestPriorityDefault = 0, // Given by the request type
+	TKAPIRequestPriorityInteractive,
+	TKAPIRequestPrioritySync,
+};
+
 FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 
 
@@ -91,6 +100,7 @@ FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 @property (nonatomic, copy) NSString *languageID;
 @property (nonatomic, copy, readonly) NSString *hostname;
 @property (nonatomic, readonly) BOOL isAlphaEnvironment; // Private
+@property (atomic) BOOL compressesRequestBodies; // Allows gzip-encoded bodies, defaults to YES
 
 // Shared sigleton
 @property (class, readonly, strong) TKAPI *sharedAPI;
@@ -102,6 +112,16 @@ FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 - (NSString *)pathForRequestType:(TKAPIRequestType)type;
 - (NSString *)pathForRequestType:(TKAPIRequestType)type ID:(NSString *)ID;
 
+// Whether responses of the request type may be kept by the response cache
+- (BOOL)responseCachingAllowedForRequestType:(TKAPIRequestType)type;
+
+// Scheduling attributes of the request type
+- (TKAPIRequestPriority)priorityForRequestType:(TKAPIRequestType)type;
+- (NSUInteger)concurrencyLimitForRequestType:(TKAPIRequestType)type;
+
+// Number of retries of a failed request of the type, zero for non-idempotent types
+- (NSUInteger)retryLimitForRequestType:(TKAPIRequestType)type;
+
 @end
 
 
@@ -128,6 +148,148 @@ FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 @end
 
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - Request coalescer -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+typedef void (^TKAPIFlightCompletion)(id result, TKAPIError *error);
+
+// Single-flight registry attaching callers asking for the same resource
+// to the request already pending for it. Keys are canonical resource identities
+// prefixed by the kind of the resource, ie. "place|poi:530".
+@interface TKAPIRequestCoalescer : NSObject
+
+// Shared sigleton
+@property (class, readonly, strong) TKAPIRequestCoalescer *sharedCoalescer;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+// Attaches the completion to a pending flight and returns YES. When there is no
+// such flight, a new one is begun with the caller as its leader and NO is returned.
+// The leader is responsible for calling -finishFlightWithKey:result:error: exactly once.
+- (BOOL)joinFlightWithKey:(NSString *)key completion:(TKAPIFlightCompletion)completion;
+
+// Whether any completion other than the leader's is attached to the pending flight
+- (BOOL)isFlightWithKeyJoined:(NSString *)key;
+
+// Finishes the flight, passing the result or the error to all attached completions
+- (void)finishFlightWithKey:(NSString *)key result:(id)result error:(TKAPIError *)error;
+
+// Calls the start block unless a flight with the key is pending. The start block
+// receives a block finishing the flight, the completion gets called either way.
+- (void)performFlightWithKey:(NSString *)key
+	start:(void (^)(TKAPIFlightCompletion finish))start completion:(TKAPIFlightCompletion)completion;
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - Response cache -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+// Raw HTTP response of an idempotent request kept along with its validators
+@interface TKAPICachedResponse : NSObject
+
+@property (nonatomic, copy) NSData *data;
+@property (nonatomic, copy) NSDictionary<NSString *, NSString *> *headers;
+@property (nonatomic, copy) NSString *ETag;
+@property (nonatomic, copy) NSString *lastModified;
+@property (nonatomic, strong) NSDate *expirationDate; // End of the freshness lifetime
+@property (nonatomic, strong) NSDate *staleDate; // End of the stale-while-revalidate window
+
+@property (nonatomic, readonly, getter=isFresh) BOOL fresh;
+@property (nonatomic, readonly, getter=isServableWhileRevalidating) BOOL servableWhileRevalidating;
+@property (nonatomic, readonly) BOOL hasValidators;
+
+// Sets the conditional request header fields matching the validators
+- (void)applyValidatorsToRequest:(NSMutableURLRequest *)request;
+
+@end
+
+
+// In-memory HTTP cache of idempotent API responses keyed by request signatures.
+// Honors `Cache-Control` (max-age, no-cache, no-store, stale-while-revalidate)
+// and revalidates stale responses using `ETag` and `Last-Modified`.
+// Streamed responses (places queries) are not cached to keep their bodies from
+// being held whole -- their results are cached per tile by the places manager.
+@interface TKAPIResponseCache : NSObject
+
+// Shared sigleton
+@property (class, readonly, strong) TKAPIResponseCache *sharedCache;
+
+// Size limit of the kept response bodies
+@property (atomic) NSUInteger byteBudget;
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+// Cached response usable either directly or for revalidation, nil if missing
+- (TKAPICachedResponse *)cachedResponseForKey:(NSString *)key;
+
+// Stores the response unless forbidden by its headers. Returns the stored response.
+- (TKAPICachedResponse *)storeData:(NSData *)data
+	headers:(NSDictionary<NSString *, NSString *> *)headers forKey:(NSString *)key;
+
+// Prolongs the cached response using headers of a Not Modified response
+- (TKAPICachedResponse *)refreshResponse:(TKAPICachedResponse *)cached
+	headers:(NSDictionary<NSString *, NSString *> *)headers forKey:(NSString *)key;
+
+// Revalidates the cached response in background unless already being revalidated
+- (void)revalidateResponse:(TKAPICachedResponse *)cached forKey:(NSString *)key request:(NSURLRequest *)request;
+
+- (void)removeAllResponses;
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - Request scheduler -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+@class TKAPIRequest;
+
+// Scheduler starting requests by their priority while respecting per-type concurrency
+// limits. Part of the slots is reserved for interactive requests so user-facing calls
+// never queue behind synchronization. Requests only time out once started.
+@interface TKAPIRequestScheduler : NSObject
+
+// Shared sigleton
+@property (class, readonly, strong) TKAPIRequestScheduler *sharedScheduler;
+
+@property (atomic) NSUInteger maximumConcurrentRequests; // All priorities together
+@property (atomic) NSUInteger maximumBackgroundRequests; // Requests of the sync priority
+
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+
+// Enqueues the request
+- (void)scheduleRequest:(TKAPIRequest *)request;
+
+// Removes a not yet started request. Returns NO if not pending.
+- (BOOL)unscheduleRequest:(TKAPIRequest *)request;
+
+// Releases the slot of a finished request
+- (void)requestDidFinish:(TKAPIRequest *)request;
+
+@end
+
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -146,13 +308,23 @@ FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 @property (atomic) TKAPIRequestState state;
 @property (nonatomic) BOOL silent;
 
+@property (atomic) TKAPIRequestPriority priority; // Defaults to the priority of the type
+@property (nonatomic) BOOL compressesBody; // Sends large bodies gzip-encoded
+
 @property (nonatomic, weak) NSOperationQueue *completionQueue; // Defaults to dedicated queue
+@property (class, nonatomic, readonly) NSOperationQueue *responseQueue; // Dedicated completion queue
 
 - (instancetype)init UNAVAILABLE_ATTRIBUTE;
 + (instancetype)new  UNAVAILABLE_ATTRIBUTE;
 
 @property (nonatomic, readonly) NSString *typeString;
 
+// Canonical signature of the request -- HTTP method, URL and query parameters sorted by name
+@property (nonatomic, readonly) NSString *signature;
+
+// Additional HTTP header fields
+- (void)setValue:(NSString *)value forHTTPHeaderField:(NSString *)field;
+
 
 ////////////////////
 #pragma mark - Predefined requests
@@ -190,6 +362,18 @@ FOUNDATION_EXPORT NSString * const TKAPIErrorDomain;
 	success:(void (^)(NSArray<TKPlace *> *places))success
 		failure:(TKAPIFailureBlock)failure;
 
+// Variant also delivering the response and the raw items matching the places, each item
+// encoded as a compact JSON object
+- (instancetype)initAsPlacesRequestForQuery:(TKPlacesQuery *)query
+	responseSuccess:(void (^)(TKAPIResponse *response, NSArray<TKPlace *> *places,
+		NSArray<NSData *> *items))success
+		failure:(TKAPIFailureBlock)failure;
+
+// Variant decoding the places into a compact store, creating place objects lazily
+- (instancetype)initAsPlacesRequestForQuery:(TKPlacesQuery *)query
+	storeSuccess:(void (^)(TKAPIResponse *response, TKPlacesStore *store))success
+		failure:(TKAPIFailureBlock)failure;
+
 ////////////////////
 // Places Batch
 
@@ -6,6 +6,8 @@
 //  Copyright (c) 2013 Tripomatic. All rights reserved.
 //
 
+#import <zlib.h>
+
 #import <TravelKit/TravelKit.h>
 #import <TravelKit/NSObject+Parsing.h>
 #import <TravelKit/NSDate+Tripomatic.h>
@@ -19,7 +21,211 @@
 #import "TKDirection+Private.h"
 #import "TKMedium+Private.h"
 #import "TKEventsManager+Private.h"
+#import "TKJSONStreamParser+Private.h"
+#import "TKPlacesStore+Private.h"
+
+
+/// Case-insensitive lookup of a HTTP header field value
+static NSString *TKAPIHeaderValue(NSDictionary<NSString *, NSString *> *headers, NSString *field)
+{
+	NSString *value = headers[field];
+
+	if (value) return value;
+
+	for (NSString *key in headers)
+		if ([key caseInsensitiveCompare:field] == NSOrderedSame)
+			return headers[key];
+
+	return nil;
+}
+
+/// Whether the query value character is passed unescaped --
+/// the `URLQueryAllowedCharacterSet` without the `+=?&` delimiters
+static inline BOOL TKAPIQueryCharacterAllowed(unsigned char c)
+{
+	static BOOL table[256];
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		const char *allowed = "abcdefghijklmnopqrstuvwxyz" "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"0123456789" "!$'()*,-./:;@_~";
+		for (const char *a = allowed; *a; a++)
+			table[(unsigned char)*a] = YES;
+	});
+
+	return table[c];
+}
+
+/// URL of the base string with the percent-encoded query parameters appended in order
+/// of their names, so equal queries always give byte-identical URLs. The URL string
+/// is sized up front and written into a single buffer.
+static NSURL *TKAPIURLWithQuery(NSString *base, NSDictionary<NSString *, NSString *> *query)
+{
+	static const char hex[] = "0123456789ABCDEF";
+
+	NSArray<NSString *> *keys = [query.allKeys sortedArrayUsingSelector:@selector(compare:)];
+	NSUInteger count = keys.count;
+
+	const char *baseBytes = base.UTF8String ?: "";
+	const char *keyBytes[count + 1], *valueBytes[count + 1];
+	size_t length = strlen(baseBytes);
+
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		keyBytes[i] = keys[i].UTF8String ?: "";
+		valueBytes[i] = query[keys[i]].UTF8String ?: "";
+
+		// Separator, key and '='
+		length += 2 + strlen(keyBytes[i]);
+
+		for (const char *c = valueBytes[i]; *c; c++)
+			length += (TKAPIQueryCharacterAllowed((unsigned char)*c)) ? 1 : 3;
+	}
+
+	char *buffer = malloc(length);
+	if (!buffer) return nil;
+
+	char *w = buffer;
+	char separator = (strchr(baseBytes, '?')) ? '&' : '?';
+
+	size_t baseLength = strlen(baseBytes);
+	memcpy(w, baseBytes, baseLength); w += baseLength;
+
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		*w++ = separator;
+		separator = '&';
+
+		size_t keyLength = strlen(keyBytes[i]);
+		memcpy(w, keyBytes[i], keyLength); w += keyLength;
+		*w++ = '=';
+
+		for (const char *c = valueBytes[i]; *c; c++)
+		{
+			unsigned char ch = (unsigned char)*c;
+
+			if (TKAPIQueryCharacterAllowed(ch)) *w++ = (char)ch;
+			else {
+				*w++ = '%';
+				*w++ = hex[ch >> 4];
+				*w++ = hex[ch & 0x0F];
+			}
+		}
+	}
+
+	CFURLRef URL = CFURLCreateWithBytes(kCFAllocatorDefault,
+		(const UInt8 *)buffer, (CFIndex)length, kCFStringEncodingUTF8, NULL);
+
+	free(buffer);
+
+	return CFBridgingRelease(URL);
+}
+
+/// Parameter string of the flags set in the mask, joined by the operator in order of the flag values.
+/// Strings are cached per mask as the same combinations are asked for over and over.
+static NSString *TKAPIFlagsString(NSCache<NSString *, NSString *> *cache,
+	NSDictionary<NSNumber *, NSString *> *strings, NSUInteger mask, NSString *operator)
+{
+	NSString *cacheKey = [NSString stringWithFormat:@"%tx%@", mask, operator];
+	NSString *cached = [cache objectForKey:cacheKey];
+
+	if (cached) return cached;
+
+	NSMutableArray<NSString *> *components = [NSMutableArray arrayWithCapacity:4];
+
+	for (NSNumber *flag in [strings.allKeys sortedArrayUsingSelector:@selector(compare:)])
+	{
+		if (!(mask & flag.unsignedIntegerValue)) continue;
+		NSString *string = strings[flag];
+		if (string) [components addObject:string];
+	}
+
+	NSString *joined = [components componentsJoinedByString:operator];
+	[cache setObject:joined forKey:cacheKey];
+
+	return joined;
+}
+
+static NSString *TKAPILevelsString(TKPlaceLevel levels)
+{
+	static NSCache<NSString *, NSString *> *cache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		cache = [NSCache new];
+		cache.countLimit = 64;
+	});
+
+	return TKAPIFlagsString(cache, [TKPlace levelStrings], levels, @"|");
+}
+
+static NSString *TKAPICategoriesString(TKPlaceCategory categories, NSString *operator)
+{
+	static NSCache<NSString *, NSString *> *cache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		cache = [NSCache new];
+		cache.countLimit = 128;
+	});
+
+	return TKAPIFlagsString(cache, [TKPlace categorySlugs], categories, operator);
+}
+
+// Request bodies smaller than this are sent as they are
+static const NSUInteger kTKAPICompressionThreshold = 8 * 1024;
+
+// Size of the chunks the compressor processes at once
+static const NSUInteger kTKAPICompressionChunkSize = 16 * 1024;
+
+/// Gzip-encoded data, compressed chunk by chunk into a growing buffer. Returns `nil` on failure.
+static NSData *TKAPIGzipData(NSData *data)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+
+	// Window bits over 15 select the gzip wrapper
+	if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+	      15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return nil;
+
+	NSMutableData *compressed = [NSMutableData dataWithCapacity:data.length / 4];
+	const Bytef *input = data.bytes;
+	NSUInteger remaining = data.length;
+	Bytef chunk[kTKAPICompressionChunkSize];
+	int status = Z_OK;
+
+	do {
+		uInt inputLength = (uInt)MIN(remaining, kTKAPICompressionChunkSize);
+		int flush = (remaining <= kTKAPICompressionChunkSize) ? Z_FINISH : Z_NO_FLUSH;
+
+		stream.next_in = (Bytef *)input;
+		stream.avail_in = inputLength;
+
+		do {
+			stream.next_out = chunk;
+			stream.avail_out = (uInt)kTKAPICompressionChunkSize;
+
+			status = deflate(&stream, flush);
+
+			if (status == Z_STREAM_ERROR) {
+				deflateEnd(&stream);
+				return nil;
+			}
+
+			[compressed appendBytes:chunk length:kTKAPICompressionChunkSize - stream.avail_out];
 
+		} while (stream.avail_out == 0);
+
+		input += inputLength;
+		remaining -= inputLength;
+
+	} while (status != Z_STREAM_END);
+
+	deflateEnd(&stream);
+
+	return compressed;
+}
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -79,6 +285,8 @@
 		if (![self isMemberOfClass:[TKAPI class]])
 			@throw @"API class cannot be inherited";
 
+		_compressesRequestBodies = YES;
+
 		[self refreshServerProperties];
 	}
 
@@ -232,6 +440,85 @@
 	}
 }
 
+- (TKAPIRequestPriority)priorityForRequestType:(TKAPIRequestType)type
+{
+	switch (type)
+	{
+		// User-initiated requests stay interactive, synchronization
+		// manager raises its own requests to Sync when enqueueing
+		case TKAPIRequestTypeTripsBatchGET:
+		case TKAPIRequestTypeChangesGET:
+			return TKAPIRequestPrioritySync;
+
+		default: return TKAPIRequestPriorityInteractive;
+	}
+}
+
+- (NSUInteger)concurrencyLimitForRequestType:(TKAPIRequestType)type
+{
+	switch (type)
+	{
+		case TKAPIRequestTypePlacesQueryGET:
+			return 6;
+
+		case TKAPIRequestTypePlacesBatchGET:
+			return 3;
+
+		case TKAPIRequestTypeTripsBatchGET:
+			return 2;
+
+		case TKAPIRequestTypeChangesGET:
+			return 1;
+
+		default: return 4;
+	}
+}
+
+- (NSUInteger)retryLimitForRequestType:(TKAPIRequestType)type
+{
+	switch (type)
+	{
+		// Queries and reads
+		case TKAPIRequestTypePlacesQueryGET:
+		case TKAPIRequestTypePlacesBatchGET:
+		case TKAPIRequestTypePlaceGET:
+		case TKAPIRequestTypeCollectionsQueryGET:
+		case TKAPIRequestTypeToursQueryGET:
+		case TKAPIRequestTypeMediaGET:
+		case TKAPIRequestTypeTripGET:
+		case TKAPIRequestTypeTripsBatchGET:
+		case TKAPIRequestTypeChangesGET:
+		case TKAPIRequestTypeDirectionsGET:
+		case TKAPIRequestTypeExchangeRatesGET:
+			return 3;
+
+		// Repeatable modifications
+		case TKAPIRequestTypeTripUPDATE:
+		case TKAPIRequestTypeFavoriteADD:
+		case TKAPIRequestTypeFavoriteDELETE:
+		case TKAPIRequestTypeTrashEMPTY:
+			return 2;
+
+		// Trip creation and custom requests may not be repeated safely
+		default: return 0;
+	}
+}
+
+- (BOOL)responseCachingAllowedForRequestType:(TKAPIRequestType)type
+{
+	switch (type)
+	{
+		case TKAPIRequestTypePlaceGET:
+		case TKAPIRequestTypeMediaGET:
+		case TKAPIRequestTypeCollectionsQueryGET:
+		case TKAPIRequestTypeToursQueryGET:
+		case TKAPIRequestTypeExchangeRatesGET:
+			return YES;
+
+		default: return NO;
+	}
+}
+
 @end
 
 
@@ -265,12 +552,25 @@
 
 @property (atomic) BOOL silent;
 
+// Collector parsing the response by chunks as they arrive, optional
+@property (nonatomic, strong) TKJSONStreamCollector *streamCollector;
+
+// Response cache key, successful responses are stored when set
+@property (nonatomic, copy) NSString *cacheKey;
+
+// Cached response being revalidated, replayed on Not Modified response
+@property (nonatomic, strong) TKAPICachedResponse *cachedResponse;
+
+// Number of retries allowed on transient failures, defaults to none
+@property (atomic) NSUInteger maximumRetries;
+
 // Initializers
 - (instancetype)initWithURLRequest:(NSMutableURLRequest *)request
 	success:(TKAPISuccessBlock)success failure:(TKAPIFailureBlock)failure;
 
 // Connection control
 - (BOOL)start;
+- (BOOL)startWithCachedResponse:(TKAPICachedResponse *)cached;
 - (BOOL)cancel;
 
 @end
@@ -287,8 +587,6 @@
 
 @interface TKAPIRequest () <TKAPIConnectionDelegate>
 
-@property (class, nonatomic, readonly) NSOperationQueue *responseQueue;
-
 @property (nonatomic, copy) NSString *path;
 @property (nonatomic, copy) NSString *pathID;
 @property (nonatomic, copy) NSDictionary<NSString *, NSString *> *query;
@@ -299,6 +597,20 @@
 @property (nonatomic, copy) TKAPISuccessBlock successBlock;
 @property (nonatomic, copy) TKAPIFailureBlock failureBlock;
 
+// Key path of an array in the response handed over element by element while downloading
+@property (nonatomic, copy) NSArray<NSString *> *streamedItemsPath;
+@property (nonatomic, copy) void (^streamedItemHandler)(id item);
+@property (nonatomic, strong) id<TKJSONStreamParserDelegate> streamedItemsDelegate;
+
+// Set when the server refused a compressed body, the request is then sent once more as is
+@property (atomic) BOOL resendsUncompressed;
+
+// Actually starts the request, called by the scheduler
+- (void)startConnection;
+
+// Finishes a request cancelled before being started
+- (void)failUnstartedWithError:(TKAPIError *)error;
+
 @end
 
 @implementation TKAPIRequest
@@ -339,32 +651,18 @@
 {
 	_state = TKAPIRequestStatePending;
 
+	[[TKAPIRequestScheduler sharedScheduler] scheduleRequest:self];
+}
+
+- (void)startConnection
+{
 	TKAPI *api = [TKAPI sharedAPI];
 
 	if (!_path) _path = [api pathForRequestType:_type ID:_pathID];
 
 	NSString *urlString = [api URLStringForRequestType:_type path:_path];
 
-	if (_query.count) {
-
-		NSMutableCharacterSet *set = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
-		[set removeCharactersInString:@"+=?&"];
-
-		NSMutableArray<NSString *> *items = [NSMutableArray arrayWithCapacity:4];
-
-		[_query enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *val, BOOL *__unused stop) {
-			val = [val stringByAddingPercentEncodingWithAllowedCharacters:set];
-			[items addObject:[NSString stringWithFormat:@"%@=%@", key, val]];
-		}];
-
-		NSString *query = [items componentsJoinedByString:@"&"];
-		NSString *sep = [urlString containsString:@"?"] ? @"&":@"?";
-		query = [NSString stringWithFormat:@"%@%@", sep, query];
-
-		urlString = [urlString stringByAppendingString:query];
-	}
-
-	NSURL *url = [NSURL URLWithString:urlString];
+	NSURL *url = TKAPIURLWithQuery(urlString, _query);
 
 	NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
 	request.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
@@ -379,10 +677,25 @@
 
 	request.timeoutInterval = timeout;
 
+	BOOL bodyCompressed = NO;
+
 	if (_data.length) {
-		[request setHTTPBody:_data];
+
+		NSData *body = _data;
+
+		// Large bodies of opted-in requests are sent compressed when it pays off
+		if (_compressesBody && api.compressesRequestBodies && body.length >= kTKAPICompressionThreshold) {
+			NSData *compressed = TKAPIGzipData(body);
+			if (compressed.length && compressed.length < body.length) {
+				body = compressed;
+				bodyCompressed = YES;
+				[request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+			}
+		}
+
+		[request setHTTPBody:body];
 		[request setValue:@"application/json" forHTTPHeaderField:@"Content-Type"];
-		[request setValue:[NSString stringWithFormat:@"%tu", _data.length] forHTTPHeaderField:@"Content-Length"];
+		[request setValue:[NSString stringWithFormat:@"%tu", body.length] forHTTPHeaderField:@"Content-Length"];
 	}
 
 	NSString *apiKey = _APIKey ?: api.APIKey;
@@ -411,6 +724,13 @@
 	};
 
 	TKAPIFailureBlock failure = ^(TKAPIError *error) {
+		// Servers not accepting the encoding reject the body as a whole,
+		// the failure is kept back until the uncompressed retry finishes
+		NSInteger status = self->_connection.responseStatus;
+		if (bodyCompressed && (status == 415 || status == 400)) {
+			self->_resendsUncompressed = YES;
+			return;
+		}
 		self->_state = TKAPIRequestStateFinished;
 		TKAPIFailureBlock failureBlock = self->_failureBlock;
 		if (failureBlock)
@@ -423,6 +743,48 @@
 	_connection.identifier = self.typeString;
 	_connection.delegate = self;
 	_connection.silent = _silent;
+	_connection.maximumRetries = [api retryLimitForRequestType:_type];
+
+	if (_streamedItemsDelegate)
+		_connection.streamCollector = [[TKJSONStreamCollector alloc]
+			initWithItemsPath:_streamedItemsPath itemsDelegate:_streamedItemsDelegate];
+	else if (_streamedItemsPath)
+		_connection.streamCollector = [[TKJSONStreamCollector alloc]
+			initWithItemsPath:_streamedItemsPath itemHandler:_streamedItemHandler];
+
+	// Idempotent requests go through the response cache. Requests carrying
+	// own validators are revalidated by the caller and bypass it. Streamed
+	// responses bypass it too, keeping the whole body for the cache would
+	// undo streaming -- their callers cache the decoded results instead.
+	BOOL cacheable = [api responseCachingAllowedForRequestType:_type] &&
+		!_connection.streamCollector &&
+		![request valueForHTTPHeaderField:@"If-None-Match"] &&
+		![request valueForHTTPHeaderField:@"If-Modified-Since"];
+
+	if (cacheable)
+	{
+		TKAPIResponseCache *responseCache = [TKAPIResponseCache sharedCache];
+		NSString *cacheKey = self.signature;
+		TKAPICachedResponse *cached = [responseCache cachedResponseForKey:cacheKey];
+
+		_connection.cacheKey = cacheKey;
+
+		if (cached.fresh) {
+			[_connection startWithCachedResponse:cached];
+			return;
+		}
+
+		if (cached.servableWhileRevalidating) {
+			[_connection startWithCachedResponse:cached];
+			[responseCache revalidateResponse:cached forKey:cacheKey request:request];
+			return;
+		}
+
+		if (cached.hasValidators) {
+			[cached applyValidatorsToRequest:request];
+			_connection.cachedResponse = cached;
+		}
+	}
 
 	[_connection start];
 }
@@ -433,12 +795,58 @@
 	[self start];
 }
 
+- (NSString *)signature
+{
+	TKAPI *api = [TKAPI sharedAPI];
+
+	NSString *path = _path ?: [api pathForRequestType:_type ID:_pathID];
+	NSString *urlString = [api URLStringForRequestType:_type path:path];
+
+	// Same URL as sent, parameters are ordered by their names
+	NSURL *url = TKAPIURLWithQuery(urlString, _query);
+
+	return [NSString stringWithFormat:@"%@ %@", [api HTTPMethodForRequestType:_type],
+		url.absoluteString ?: urlString];
+}
+
+- (void)setValue:(NSString *)value forHTTPHeaderField:(NSString *)field
+{
+	NSMutableDictionary<NSString *, NSString *> *headers = [_HTTPHeaders mutableCopy] ?: [NSMutableDictionary new];
+	headers[field] = value;
+	_HTTPHeaders = [headers copy];
+}
+
 - (void)cancel
 {
+	// Requests not started yet are failed right away
+	if ([[TKAPIRequestScheduler sharedScheduler] unscheduleRequest:self]) {
+		[self failUnstartedWithError:[TKAPIError errorWithDomain:NSURLErrorDomain
+			code:NSURLErrorCancelled userInfo:nil]];
+		return;
+	}
+
 	_state = TKAPIRequestStateFinished;
 	[_connection cancel];
 }
 
+- (void)failUnstartedWithError:(TKAPIError *)error
+{
+	_state = TKAPIRequestStateFinished;
+
+	TKAPIFailureBlock failureBlock = _failureBlock;
+	NSOperationQueue *queue = _completionQueue ?: [self.class responseQueue];
+
+	_successBlock = nil;
+	_failureBlock = nil;
+	_streamedItemHandler = nil;
+	_streamedItemsDelegate = nil;
+
+	if (failureBlock)
+		[queue addOperationWithBlock:^{
+			failureBlock(error);
+		}];
+}
+
 
 ////////////////////
 #pragma mark - Connection delegate
@@ -447,9 +855,21 @@
 
 - (void)connectionDidFinish:(__unused TKAPIConnection *)connection
 {
+	// Refused compressed body, the request keeps its scheduler slot and goes once more
+	if (_resendsUncompressed) {
+		_resendsUncompressed = NO;
+		_compressesBody = NO;
+		[self startConnection];
+		return;
+	}
+
 	_connection = nil;
 	_successBlock = nil;
 	_failureBlock = nil;
+	_streamedItemHandler = nil;
+	_streamedItemsDelegate = nil;
+
+	[[TKAPIRequestScheduler sharedScheduler] requestDidFinish:self];
 }
 
 
@@ -599,6 +1019,7 @@
 	{
 		_type = TKAPIRequestTypeTripNEW;
 		_data = [[trip asRequestDictionary] asJSONData];
+		_compressesBody = YES;
 
 		_successBlock = ^(TKAPIResponse *response){
 
@@ -625,6 +1046,7 @@
 	if (self = [super init])
 	{
 		_type = TKAPIRequestTypeTripUPDATE;
+		_compressesBody = YES;
 		_pathID = [trip.ID copy];
 		_data = [[trip asRequestDictionary] asJSONData];
 
@@ -694,18 +1116,19 @@
 		_type = TKAPIRequestTypeTripsBatchGET;
 		_query = @{ @"ids": [tripIDs componentsJoinedByString:@"|"] ?: @"" };
 
-		_successBlock = ^(TKAPIResponse *response){
+		NSMutableArray<TKTrip *> *trips = [NSMutableArray arrayWithCapacity:tripIDs.count];
 
-			NSArray *tripsArray = [response.data[@"trips"] parsedArray];
-			NSMutableArray<TKTrip *> *trips = [NSMutableArray array];
+		// Trips are built one by one while the response is being downloaded
+		_streamedItemsPath = @[ @"data", @"trips" ];
+		_streamedItemHandler = ^(NSDictionary *dict) {
 
-			for (NSDictionary *dict in tripsArray)
-			{
-				if (![dict parsedDictionary]) continue;
+			if (![dict parsedDictionary]) return;
 
-				TKTrip *t = [[TKTrip alloc] initFromResponse:dict];
-				if (t) [trips addObject:t];
-			}
+			TKTrip *t = [[TKTrip alloc] initFromResponse:dict];
+			if (t) [trips addObject:t];
+		};
+
+		_successBlock = ^(TKAPIResponse *__unused response){
 
 			if (success)
 				success(trips);
@@ -724,8 +1147,40 @@
 ////////////////////
 
 
+/// Place built from a streamed item of the places response
+static TKPlace *TKAPIPlaceFromStreamedItem(NSDictionary *dict)
+{
+	if (![dict parsedDictionary]) return nil;
+	if (![dict[@"id"] parsedString]) return nil;
+
+	return [[TKPlace alloc] initFromResponse:dict];
+}
+
+
 - (instancetype)initAsPlacesRequestForQuery:(TKPlacesQuery *)query
 	success:(void (^)(NSArray<TKPlace *> *))success failure:(TKAPIFailureBlock)failure
+{
+	if (self = [self initAsPlacesRequestForQuery:query responseSuccess:nil failure:failure])
+	{
+		NSMutableArray<TKPlace *> *stored = [NSMutableArray array];
+
+		// Raw items are of no use here, only places are kept
+		_streamedItemHandler = ^(NSDictionary *dict) {
+			TKPlace *a = TKAPIPlaceFromStreamedItem(dict);
+			if (a) [stored addObject:a];
+		};
+
+		_successBlock = ^(TKAPIResponse *__unused response){
+			if (success) success(stored);
+		};
+	}
+
+	return self;
+}
+
+- (instancetype)initAsPlacesRequestForQuery:(TKPlacesQuery *)query
+	responseSuccess:(void (^)(TKAPIResponse *, NSArray<TKPlace *> *, NSArray<NSData *> *))success
+		failure:(TKAPIFailureBlock)failure
 {
 	if (self = [super init])
 	{
@@ -738,18 +1193,7 @@
 
 		if (query.levels)
 		{
-			NSMutableArray<NSString *> *levels = [NSMutableArray arrayWithCapacity:3];
-			NSDictionary<NSNumber *, NSString *> *supportedLevels = [TKPlace levelStrings];
-
-			for (NSNumber *sl in supportedLevels.allKeys)
-			{
-				TKPlaceLevel cl = sl.unsignedIntegerValue;
-				if (!(query.levels & cl)) continue;
-				NSString *lev = supportedLevels[sl];
-				if (lev) [levels addObject:lev];
-			}
-
-			NSString *lstr = [levels componentsJoinedByString:@"|"];
+			NSString *lstr = TKAPILevelsString(query.levels);
 
 			if (lstr.length) queryDict[@"levels"] = lstr;
 		}
@@ -779,19 +1223,8 @@
 
 		if (query.categories)
 		{
-			NSMutableArray<NSString *> *slugs = [NSMutableArray arrayWithCapacity:3];
-			NSDictionary<NSNumber *, NSString *> *supportedSlugs = [TKPlace categorySlugs];
-
-			for (NSNumber *sl in supportedSlugs.allKeys)
-			{
-				TKPlaceCategory cat = sl.unsignedIntegerValue;
-				if (!(query.categories & cat)) continue;
-				NSString *slug = supportedSlugs[sl];
-				if (slug) [slugs addObject:slug];
-			}
-
 			NSString *operator = (query.categoriesMatching == TKPlacesQueryMatchingAll) ? @"," : @"|";
-			queryDict[@"categories"] = [slugs componentsJoinedByString:operator];
+			queryDict[@"categories"] = TKAPICategoriesString(query.categories, operator);
 		}
 
 		if (query.tags.count)
@@ -824,23 +1257,26 @@
 
 		_query = queryDict;
 
-		_successBlock = ^(TKAPIResponse *response){
+		NSMutableArray<TKPlace *> *stored = [NSMutableArray array];
+		NSMutableArray<NSData *> *storedItems = [NSMutableArray array];
 
-			NSMutableArray<TKPlace *> *stored = [NSMutableArray array];
-			NSArray *items = [response.data[@"places"] parsedArray];
+		// Places are built one by one while the response is being downloaded,
+		// raw items are kept re-encoded as compact JSON rather than as object trees
+		_streamedItemsPath = @[ @"data", @"places" ];
+		_streamedItemHandler = ^(NSDictionary *dict) {
 
-			for (NSDictionary *dict in items)
-			{
-				if (![dict parsedDictionary]) continue;
-				NSString *guid = [dict[@"id"] parsedString];
-				if (!guid) continue;
+			TKPlace *a = TKAPIPlaceFromStreamedItem(dict);
+			if (!a) return;
 
-				TKPlace *a = [[TKPlace alloc] initFromResponse:dict];
-				if (a) [stored addObject:a];
-			}
+			NSData *item = [NSJSONSerialization dataWithJSONObject:dict options:kNilOptions error:nil];
+			if (!item) return;
 
-			if (success) success(stored);
+			[stored addObject:a];
+			[storedItems addObject:item];
+		};
 
+		_successBlock = ^(TKAPIResponse *response){
+			if (success) success(response, stored, storedItems);
 		}; _failureBlock = ^(TKAPIError *error){
 			if (failure) failure(error);
 		};
@@ -849,6 +1285,25 @@
 	return self;
 }
 
+- (instancetype)initAsPlacesRequestForQuery:(TKPlacesQuery *)query
+	storeSuccess:(void (^)(TKAPIResponse *, TKPlacesStore *))success failure:(TKAPIFailureBlock)failure
+{
+	if (self = [self initAsPlacesRequestForQuery:query responseSuccess:nil failure:failure])
+	{
+		// Places are decoded straight into the store while the response is being downloaded
+		TKPlacesStoreDecoder *decoder = [TKPlacesStoreDecoder new];
+
+		_streamedItemHandler = nil;
+		_streamedItemsDelegate = decoder;
+
+		_successBlock = ^(TKAPIResponse *response){
+			if (success) success(response, decoder.store);
+		};
+	}
+
+	return self;
+}
+
 
 ////////////////////
 #pragma mark - Places Batch
@@ -1481,13 +1936,463 @@
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-#pragma mark - API response -
+#pragma mark - Request coalescer -
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
 
-@implementation TKAPIResponse
+@implementation TKAPIRequestCoalescer
+{
+	NSMutableDictionary<NSString *, NSMutableArray<TKAPIFlightCompletion> *> *_flights;
+}
+
++ (TKAPIRequestCoalescer *)sharedCoalescer
+{
+	static TKAPIRequestCoalescer *shared = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		shared = [[self alloc] init];
+	});
+
+	return shared;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_flights = [NSMutableDictionary dictionaryWithCapacity:32];
+	}
+
+	return self;
+}
+
+- (BOOL)joinFlightWithKey:(NSString *)key completion:(TKAPIFlightCompletion)completion
+{
+	@synchronized (self) {
+
+		NSMutableArray<TKAPIFlightCompletion> *waiting = _flights[key];
+
+		if (waiting) {
+			if (completion) [waiting addObject:[completion copy]];
+			return YES;
+		}
+
+		_flights[key] = [NSMutableArray arrayWithCapacity:2];
+
+		return NO;
+	}
+}
+
+- (BOOL)isFlightWithKeyJoined:(NSString *)key
+{
+	@synchronized (self) {
+		return _flights[key].count > 0;
+	}
+}
+
+- (void)finishFlightWithKey:(NSString *)key result:(id)result error:(TKAPIError *)error
+{
+	NSArray<TKAPIFlightCompletion> *waiting = nil;
+
+	@synchronized (self) {
+		waiting = _flights[key];
+		[_flights removeObjectForKey:key];
+	}
+
+	// Completions are called outside of the lock as they may begin new flights
+	for (TKAPIFlightCompletion completion in waiting)
+		completion(result, error);
+}
+
+- (void)performFlightWithKey:(NSString *)key
+	start:(void (^)(TKAPIFlightCompletion))start completion:(TKAPIFlightCompletion)completion
+{
+	if ([self joinFlightWithKey:key completion:completion])
+		return;
+
+	start(^(id result, TKAPIError *error) {
+		[self finishFlightWithKey:key result:result error:error];
+		if (completion) completion(result, error);
+	});
+}
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - Response cache -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+/// Freshness lifetime and stale-while-revalidate window given by the `Cache-Control`
+/// and `Age` header fields. Returns `NO` when the response must not be stored.
+static BOOL TKAPICacheLifetime(NSDictionary<NSString *, NSString *> *headers,
+	NSTimeInterval *maxAge, NSTimeInterval *staleWindow)
+{
+	NSString *cacheControl = TKAPIHeaderValue(headers, @"Cache-Control");
+	BOOL noCache = NO;
+
+	*maxAge = 0;
+	*staleWindow = 0;
+
+	for (NSString *directive in [cacheControl componentsSeparatedByString:@","])
+	{
+		NSString *trimmed = [directive stringByTrimmingCharactersInSet:
+			[NSCharacterSet whitespaceCharacterSet]].lowercaseString;
+
+		if ([trimmed isEqualToString:@"no-store"])
+			return NO;
+		else if ([trimmed isEqualToString:@"no-cache"])
+			noCache = YES;
+		else if ([trimmed hasPrefix:@"max-age="])
+			*maxAge = MAX([trimmed substringFromIndex:8].doubleValue, 0);
+		else if ([trimmed hasPrefix:@"stale-while-revalidate="])
+			*staleWindow = MAX([trimmed substringFromIndex:23].doubleValue, 0);
+	}
+
+	// Responses requiring revalidation are never fresh
+	if (noCache) *maxAge = *staleWindow = 0;
+
+	// Time already spent in shared caches on the way
+	NSTimeInterval age = TKAPIHeaderValue(headers, @"Age").doubleValue;
+	*maxAge = MAX(*maxAge - MAX(age, 0), 0);
+
+	return YES;
+}
+
+
+@implementation TKAPICachedResponse
+
+- (BOOL)isFresh
+{
+	return _expirationDate.timeIntervalSinceNow > 0;
+}
+
+- (BOOL)isServableWhileRevalidating
+{
+	return _staleDate.timeIntervalSinceNow > 0;
+}
+
+- (BOOL)hasValidators
+{
+	return _ETag.length || _lastModified.length;
+}
+
+- (void)applyValidatorsToRequest:(NSMutableURLRequest *)request
+{
+	if (_ETag.length)
+		[request setValue:_ETag forHTTPHeaderField:@"If-None-Match"];
+
+	if (_lastModified.length)
+		[request setValue:_lastModified forHTTPHeaderField:@"If-Modified-Since"];
+}
+
+@end
+
+
+@interface TKAPIResponseCache () <TKAPIConnectionDelegate>
+@end
+
+@implementation TKAPIResponseCache
+{
+	NSCache<NSString *, TKAPICachedResponse *> *_responses;
+	NSMutableDictionary<NSString *, TKAPIConnection *> *_revalidations;
+}
+
++ (TKAPIResponseCache *)sharedCache
+{
+	static TKAPIResponseCache *shared = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		shared = [[self alloc] init];
+	});
+
+	return shared;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_responses = [NSCache new];
+		_responses.countLimit = 256;
+		_responses.totalCostLimit = 8 * 1024 * 1024;
+		_revalidations = [NSMutableDictionary dictionaryWithCapacity:8];
+	}
+
+	return self;
+}
+
+- (NSUInteger)byteBudget
+{
+	return _responses.totalCostLimit;
+}
+
+- (void)setByteBudget:(NSUInteger)byteBudget
+{
+	_responses.totalCostLimit = byteBudget;
+}
+
+- (TKAPICachedResponse *)cachedResponseForKey:(NSString *)key
+{
+	TKAPICachedResponse *cached = (key) ? [_responses objectForKey:key] : nil;
+
+	// Expired responses without validators are of no further use
+	if (cached && !cached.servableWhileRevalidating && !cached.hasValidators) {
+		[_responses removeObjectForKey:key];
+		return nil;
+	}
+
+	return cached;
+}
+
+- (TKAPICachedResponse *)storeData:(NSData *)data
+	headers:(NSDictionary<NSString *, NSString *> *)headers forKey:(NSString *)key
+{
+	if (!data.length || !key) return nil;
+
+	NSTimeInterval maxAge = 0, staleWindow = 0;
+
+	if (!TKAPICacheLifetime(headers, &maxAge, &staleWindow)) {
+		[_responses removeObjectForKey:key];
+		return nil;
+	}
+
+	TKAPICachedResponse *cached = [TKAPICachedResponse new];
+	cached.data = data;
+	cached.headers = headers;
+	cached.ETag = TKAPIHeaderValue(headers, @"ETag");
+	cached.lastModified = TKAPIHeaderValue(headers, @"Last-Modified");
+	cached.expirationDate = [NSDate dateWithTimeIntervalSinceNow:maxAge];
+	cached.staleDate = [cached.expirationDate dateByAddingTimeInterval:staleWindow];
+
+	if (!cached.servableWhileRevalidating && !cached.hasValidators) {
+		[_responses removeObjectForKey:key];
+		return nil;
+	}
+
+	[_responses setObject:cached forKey:key cost:data.length];
+
+	return cached;
+}
+
+- (TKAPICachedResponse *)refreshResponse:(TKAPICachedResponse *)cached
+	headers:(NSDictionary<NSString *, NSString *> *)headers forKey:(NSString *)key
+{
+	// Not Modified responses carry updated metadata only
+	NSMutableDictionary<NSString *, NSString *> *merged = [cached.headers mutableCopy] ?: [NSMutableDictionary new];
+	[merged addEntriesFromDictionary:headers ?: @{ }];
+
+	return [self storeData:cached.data headers:merged forKey:key];
+}
+
+- (void)revalidateResponse:(TKAPICachedResponse *)cached forKey:(NSString *)key request:(NSURLRequest *)request
+{
+	NSMutableURLRequest *conditional = [request mutableCopy];
+	[cached applyValidatorsToRequest:conditional];
+
+	TKAPIConnection *connection = [[TKAPIConnection alloc]
+		initWithURLRequest:conditional success:nil failure:nil];
+	connection.identifier = @"Revalidation";
+	connection.silent = YES;
+	connection.cacheKey = key;
+	connection.cachedResponse = cached;
+	connection.delegate = self;
+
+	@synchronized (_revalidations) {
+		if (_revalidations[key]) return;
+		_revalidations[key] = connection;
+	}
+
+	[connection start];
+}
+
+- (void)removeAllResponses
+{
+	[_responses removeAllObjects];
+}
+
+- (void)connectionDidFinish:(TKAPIConnection *)connection
+{
+	NSString *key = connection.cacheKey;
+
+	@synchronized (_revalidations) {
+		if (key && _revalidations[key] == connection)
+			[_revalidations removeObjectForKey:key];
+	}
+}
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - Request scheduler -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+/// Effective priority of the request
+static TKAPIRequestPriority TKAPIRequestEffectivePriority(TKAPIRequest *request)
+{
+	TKAPIRequestPriority priority = request.priority;
+
+	if (priority == TKAPIRequestPriorityDefault)
+		priority = [[TKAPI sharedAPI] priorityForRequestType:request.type];
+
+	return priority;
+}
+
+
+@implementation TKAPIRequestScheduler
+{
+	// Pending requests by effective priority, in order of scheduling
+	NSMutableArray<NSMutableArray<TKAPIRequest *> *> *_pending;
+	NSMutableArray<TKAPIRequest *> *_running;
+	NSCountedSet<NSNumber *> *_runningTypes;
+	NSUInteger _runningBackground;
+}
+
++ (TKAPIRequestScheduler *)sharedScheduler
+{
+	static TKAPIRequestScheduler *shared = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		shared = [[self alloc] init];
+	});
+
+	return shared;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		// Matches the default per-host connection limit of URL sessions,
+		// requests above it would otherwise time out queued in the session
+		_maximumConcurrentRequests = 6;
+		_maximumBackgroundRequests = 4;
+
+		_pending = [NSMutableArray arrayWithCapacity:TKAPIRequestPrioritySync + 1];
+		for (NSUInteger i = 0; i <= TKAPIRequestPrioritySync; i++)
+			[_pending addObject:[NSMutableArray array]];
+
+		_running = [NSMutableArray arrayWithCapacity:8];
+		_runningTypes = [NSCountedSet set];
+	}
+
+	return self;
+}
+
+- (void)scheduleRequest:(TKAPIRequest *)request
+{
+	TKAPIRequestPriority priority = TKAPIRequestEffectivePriority(request);
+
+	@synchronized (self) {
+		[_pending[priority] addObject:request];
+	}
+
+	[self startPendingRequests];
+}
+
+- (BOOL)unscheduleRequest:(TKAPIRequest *)request
+{
+	@synchronized (self) {
+
+		for (NSMutableArray<TKAPIRequest *> *queue in _pending)
+			if ([queue containsObject:request]) {
+				[queue removeObject:request];
+				return YES;
+			}
+
+		return NO;
+	}
+}
+
+- (void)requestDidFinish:(TKAPIRequest *)request
+{
+	@synchronized (self) {
+
+		NSUInteger idx = [_running indexOfObjectIdenticalTo:request];
+		if (idx == NSNotFound) return;
+
+		[_running removeObjectAtIndex:idx];
+		[_runningTypes removeObject:@(request.type)];
+
+		if (TKAPIRequestEffectivePriority(request) != TKAPIRequestPriorityInteractive)
+			_runningBackground--;
+	}
+
+	[self startPendingRequests];
+}
+
+- (void)startPendingRequests
+{
+	NSMutableArray<TKAPIRequest *> *toStart = [NSMutableArray array];
+
+	@synchronized (self) {
+
+		TKAPI *api = [TKAPI sharedAPI];
+
+		for (NSUInteger p = TKAPIRequestPriorityDefault; p <= TKAPIRequestPrioritySync; p++)
+		{
+			BOOL background = p > TKAPIRequestPriorityInteractive;
+			NSMutableIndexSet *started = [NSMutableIndexSet indexSet];
+
+			[_pending[p] enumerateObjectsUsingBlock:^(TKAPIRequest *r, NSUInteger idx, BOOL *stop) {
+
+				if (self->_running.count >= self->_maximumConcurrentRequests ||
+				    (background && self->_runningBackground >= self->_maximumBackgroundRequests)) {
+					*stop = YES;
+					return;
+				}
+
+				// Requests of a saturated type wait, others may overtake them
+				if ([self->_runningTypes countForObject:@(r.type)] >=
+				    [api concurrencyLimitForRequestType:r.type])
+					return;
+
+				[self->_running addObject:r];
+				[self->_runningTypes addObject:@(r.type)];
+				if (background) self->_runningBackground++;
+
+				[started addIndex:idx];
+				[toStart addObject:r];
+			}];
+
+			[_pending[p] removeObjectsAtIndexes:started];
+		}
+	}
+
+	// Requests are started outside of the lock as they may finish synchronously
+	for (TKAPIRequest *r in toStart)
+		[r startConnection];
+}
+
+@end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark - API response -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+@implementation TKAPIResponse
 
 - (instancetype)initWithDictionary:(NSDictionary *)dictionary
 {
@@ -1515,6 +2420,11 @@
 	return self;
 }
 
+- (NSString *)valueForHeaderField:(NSString *)field
+{
+	return TKAPIHeaderValue(_headers, field);
+}
+
 @end
 
 
@@ -1586,16 +2496,214 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 ////////////////////////////////////////////////////////////////////////////////
 
 
+// Retry backoff -- full jitter over an exponentially growing window
+static const NSTimeInterval kTKAPIRetryBaseDelay = 0.5;
+static const NSTimeInterval kTKAPIRetryMaximumDelay = 8;
+
+// Longest server-requested delay still worth waiting for
+static const NSTimeInterval kTKAPIRetryMaximumRetryAfter = 30;
+
+// Retry budget capacity and the fraction of a retry earned by each success
+static const double kTKAPIRetryBudgetCapacity = 10;
+static const double kTKAPIRetryBudgetRefill = 0.1;
+
+/// Whether the transport error may be overcome by repeating the request
+static BOOL TKAPIErrorIsTransient(NSError *error)
+{
+	if (![error.domain isEqualToString:NSURLErrorDomain])
+		return NO;
+
+	switch (error.code)
+	{
+		case NSURLErrorTimedOut:
+		case NSURLErrorCannotFindHost:
+		case NSURLErrorCannotConnectToHost:
+		case NSURLErrorNetworkConnectionLost:
+		case NSURLErrorDNSLookupFailed:
+		case NSURLErrorNotConnectedToInternet:
+		case NSURLErrorSecureConnectionFailed:
+			return YES;
+
+		default: return NO;
+	}
+}
+
+/// Delay given by the `Retry-After` header field, either in seconds or as a HTTP date
+static NSTimeInterval TKAPIRetryAfterDelay(NSURLResponse *response)
+{
+	if (![response isKindOfClass:[NSHTTPURLResponse class]]) return -1;
+
+	NSString *value = TKAPIHeaderValue([(NSHTTPURLResponse *)response allHeaderFields], @"Retry-After");
+	value = [value stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+
+	if (!value.length) return -1;
+
+	NSScanner *scanner = [NSScanner scannerWithString:value];
+	NSInteger seconds = 0;
+
+	if ([scanner scanInteger:&seconds] && scanner.atEnd)
+		return MAX(seconds, 0);
+
+	static NSDateFormatter *formatter = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		formatter = [NSDateFormatter new];
+		formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+		formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+		formatter.dateFormat = @"EEE',' dd MMM yyyy HH':'mm':'ss zzz";
+	});
+
+	NSDate *date = nil;
+
+	@synchronized (formatter) {
+		date = [formatter dateFromString:value];
+	}
+
+	return (date) ? MAX(date.timeIntervalSinceNow, 0) : -1;
+}
+
+
+/// Global token bucket limiting retries to a fraction of successful requests,
+/// so retries cannot multiply the load of a struggling server
+@interface TKAPIRetryBudget : NSObject
+
+@property (class, readonly, strong) TKAPIRetryBudget *sharedBudget;
+
+- (BOOL)withdraw;
+- (void)depositForSuccess;
+
+@end
+
+@implementation TKAPIRetryBudget
+{
+	double _tokens;
+}
+
++ (TKAPIRetryBudget *)sharedBudget
+{
+	static TKAPIRetryBudget *shared = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		shared = [[self alloc] init];
+	});
+
+	return shared;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_tokens = kTKAPIRetryBudgetCapacity;
+	}
+
+	return self;
+}
+
+- (BOOL)withdraw
+{
+	@synchronized (self) {
+		if (_tokens < 1) return NO;
+		_tokens -= 1;
+		return YES;
+	}
+}
+
+- (void)depositForSuccess
+{
+	@synchronized (self) {
+		_tokens = MIN(_tokens + kTKAPIRetryBudgetRefill, kTKAPIRetryBudgetCapacity);
+	}
+}
+
+@end
+
+
 @interface TKAPIConnection ()
 
 @property (nonatomic, strong) NSDate *startTimestamp;
 @property (nonatomic, copy) TKAPISuccessBlock successBlock;
 @property (nonatomic, copy) TKAPIFailureBlock failureBlock;
 
+// Streaming session events
+- (void)dataTaskDidReceiveResponse:(NSURLResponse *)response;
+- (void)dataTaskDidReceiveData:(NSData *)data;
+- (void)dataTaskDidCompleteWithError:(NSError *)error;
+
+@end
+
+
+@interface TKAPIStreamingSessionDelegate : NSObject <NSURLSessionDataDelegate>
+
+- (void)registerConnection:(TKAPIConnection *)connection forTask:(NSURLSessionTask *)task;
+
+@end
+
+@implementation TKAPIStreamingSessionDelegate
+{
+	NSMutableDictionary<NSNumber *, TKAPIConnection *> *_connections;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_connections = [NSMutableDictionary dictionaryWithCapacity:8];
+	}
+
+	return self;
+}
+
+- (void)registerConnection:(TKAPIConnection *)connection forTask:(NSURLSessionTask *)task
+{
+	@synchronized (self) {
+		_connections[@(task.taskIdentifier)] = connection;
+	}
+}
+
+- (TKAPIConnection *)connectionForTask:(NSURLSessionTask *)task remove:(BOOL)remove
+{
+	@synchronized (self) {
+		NSNumber *key = @(task.taskIdentifier);
+		TKAPIConnection *connection = _connections[key];
+		if (remove) [_connections removeObjectForKey:key];
+		return connection;
+	}
+}
+
+- (void)URLSession:(__unused NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask
+	didReceiveResponse:(NSURLResponse *)response completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler
+{
+	[[self connectionForTask:dataTask remove:NO] dataTaskDidReceiveResponse:response];
+	completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(__unused NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data
+{
+	[[self connectionForTask:dataTask remove:NO] dataTaskDidReceiveData:data];
+}
+
+- (void)URLSession:(__unused NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+	[[self connectionForTask:task remove:YES] dataTaskDidCompleteWithError:error];
+}
+
 @end
 
 
 @implementation TKAPIConnection
+{
+	NSURLResponse *_response;
+	NSMutableData *_bufferedData;
+	NSUInteger _streamedLength;
+	BOOL _streaming;
+	BOOL _streamFailed;
+	BOOL _replayed;
+	BOOL _cancelled;
+	NSUInteger _retries;
+}
 
 + (NSString *)userAgentString
 {
@@ -1660,6 +2768,25 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 	return session;
 }
 
++ (NSURLSession *)sharedStreamingURLSession
+{
+	static NSURLSession *session = nil;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		NSURLSessionConfiguration *config = [NSURLSessionConfiguration defaultSessionConfiguration];
+		config.requestCachePolicy = NSURLRequestReloadIgnoringCacheData;
+		config.timeoutIntervalForRequest = 4;
+		// Chunks of a single response need to be delivered in order
+		NSOperationQueue *queue = [NSOperationQueue new];
+		queue.name = @"API streaming queue";
+		queue.maxConcurrentOperationCount = 1;
+		session = [NSURLSession sessionWithConfiguration:config
+			delegate:[TKAPIStreamingSessionDelegate new] delegateQueue:queue];
+	});
+
+	return session;
+}
+
 - (instancetype)initWithURLRequest:(NSMutableURLRequest *)request
 	success:(TKAPISuccessBlock)success failure:(TKAPIFailureBlock)failure
 {
@@ -1704,6 +2831,8 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 		NSString *sep = (_silent) ? @"" : @"\n";
 		NSString *loggedData = (_silent) ?
 			@"(...)" : [[NSString alloc] initWithData:bodyData encoding:NSUTF8StringEncoding];
+		if ([_request valueForHTTPHeaderField:@"Content-Encoding"])
+			loggedData = [NSString stringWithFormat:@"(gzip %tuB)", bodyData.length];
 		loggedStr = [loggedStr stringByAppendingFormat:@"  DATA:%@%@", sep, loggedData];
 	}
 
@@ -1717,7 +2846,15 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 
 		__auto_type __weak wself = self;
 
-		_task = [[TKAPIConnection sharedURLSession] dataTaskWithRequest:_request
+		if (_streamCollector)
+		{
+			// Response is parsed by chunks as they arrive, see the streaming events below
+			NSURLSession *session = [TKAPIConnection sharedStreamingURLSession];
+			_task = [session dataTaskWithRequest:_request];
+			[(TKAPIStreamingSessionDelegate *)session.delegate registerConnection:self forTask:_task];
+		}
+
+		else _task = [[TKAPIConnection sharedURLSession] dataTaskWithRequest:_request
 		  completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
 
 			// Retain API connection
@@ -1755,13 +2892,82 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 	}
 }
 
+- (BOOL)startWithCachedResponse:(TKAPICachedResponse *)cached
+{
+#ifdef LOG_API
+	NSLog(@"[API REQUEST] ID:%@ URL:%@  CACHED", _identifier, _URL);
+#endif
+
+	_startTimestamp = [NSDate new];
+
+	dispatch_async(dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+		[self finishWithCachedResponse:cached];
+	});
+
+	return YES;
+}
+
 - (BOOL)cancel
 {
+	_cancelled = YES;
+
 	if (!_task) return NO;
 	[_task cancel];
 	return YES;
 }
 
+
+#pragma mark - Retries
+
+
+- (BOOL)retryWithServerDelay:(NSTimeInterval)serverDelay
+{
+	if (_cancelled || _retries >= self.maximumRetries)
+		return NO;
+
+	// Chunks already streamed to the collector cannot be taken back
+	if (_streamedLength)
+		return NO;
+
+	if (serverDelay > kTKAPIRetryMaximumRetryAfter)
+		return NO;
+
+	if (![[TKAPIRetryBudget sharedBudget] withdraw])
+		return NO;
+
+	NSTimeInterval window = MIN(kTKAPIRetryMaximumDelay, kTKAPIRetryBaseDelay * (double)(1 << _retries));
+	NSTimeInterval delay = window * arc4random_uniform(1001) / 1000.0;
+
+	if (serverDelay >= 0) delay = MAX(delay, serverDelay);
+
+	_retries++;
+
+#ifdef LOG_API
+	NSLog(@"[API REQUEST] ID:%@ RETRY %tu/%tu URL:%@  DELAY:%f", _identifier,
+		_retries, self.maximumRetries, _URL, delay);
+#endif
+
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+	  dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+
+		if (self->_cancelled) {
+			[self dataTaskDidFailWithError:[NSError errorWithDomain:NSURLErrorDomain
+				code:NSURLErrorCancelled userInfo:nil]];
+			return;
+		}
+
+		self->_response = nil;
+		self->_bufferedData = nil;
+		self->_streaming = NO;
+		self->_streamFailed = NO;
+		self.responseStatus = 0;
+
+		[self start];
+	});
+
+	return YES;
+}
+
 - (void)cleanupAndNotify
 {
 	if ([_delegate respondsToSelector:@selector(connectionDidFinish:)])
@@ -1775,15 +2981,56 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 #pragma mark - URL Session data task delegate
 
 
-- (void)dataTaskDidFinishWithResponse:(__unused NSURLResponse *)response data:(NSData *)data
+- (void)dataTaskDidFinishWithResponse:(NSURLResponse *)response data:(NSData *)data
 {
 	// We've got all data from the server response
 	// Now it's time to parse and process it
 
 	NSError *error = nil;
 
+	// Cached response confirmed by the server is processed as if received
+	if (_responseStatus == 304 && _cachedResponse) {
+
+		NSDictionary *headers = ([response isKindOfClass:[NSHTTPURLResponse class]]) ?
+			[(NSHTTPURLResponse *)response allHeaderFields] : nil;
+
+		TKAPICachedResponse *cached = [[TKAPIResponseCache sharedCache]
+			refreshResponse:_cachedResponse headers:headers forKey:_cacheKey] ?: _cachedResponse;
+
+		// Background revalidations only refresh the cache
+		if (_successBlock) [self finishWithCachedResponse:cached];
+		else [self cleanupAndNotify];
+
+		return;
+	}
+
+	// Throttled or temporarily unavailable servers get another try,
+	// gateway failures as well unless a delay is requested
+	if (_responseStatus == 429 || _responseStatus == 502 ||
+	    _responseStatus == 503 || _responseStatus == 504)
+		if ([self retryWithServerDelay:TKAPIRetryAfterDelay(response)])
+			return;
+
+	// Conditional requests receive an empty Not Modified response
+	if (_responseStatus == 304) {
+
+		TKAPIError *e = [TKAPIError errorWithCode:304 userInfo:nil];
+
+		if (_failureBlock) _failureBlock(e);
+
+		[self cleanupAndNotify];
+
+		return;
+	}
+
 	NSDictionary *dict = [[NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error] parsedDictionary];
 
+	[self dataTaskDidFinishWithResponse:response dictionary:dict data:data error:error];
+}
+
+- (void)dataTaskDidFinishWithResponse:(NSURLResponse *)response
+	dictionary:(NSDictionary *)dict data:(NSData *)data error:(NSError *)error
+{
 	if (!dict || error) {
 
 		if (_responseStatus >= 400 || _responseStatus < 100)
@@ -1807,11 +3054,16 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 	TKAPIResponse *resp = [[TKAPIResponse alloc] initWithDictionary:dict];
 	NSInteger code = resp.code;
 
+	if ([response isKindOfClass:[NSHTTPURLResponse class]])
+		resp.headers = [(NSHTTPURLResponse *)response allHeaderFields];
+
 #ifdef LOG_API
-	NSString *responseString = [NSString stringWithFormat:@"[%luB]", (unsigned long)data.length];
+	NSUInteger dataLength = (data) ? data.length : _streamedLength;
+	NSString *responseString = [NSString stringWithFormat:@"[%luB]", (unsigned long)dataLength];
 	NSString *dataSeparator = @"";
 
-	if (!_silent || code != 200) {
+	// Streamed responses are not kept around
+	if (data && (!_silent || code != 200)) {
 		responseString = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
 		responseString = [responseString stringByReplacingOccurrencesOfString:@"\r" withString:@""];
 		dataSeparator = @"\n";
@@ -1837,14 +3089,85 @@ NSString * const TKAPIErrorDomain = @"TKAPIErrorDomain";
 			_failureBlock(e);
 	}
 
-	else if (_successBlock)
-		_successBlock(resp);
+	else {
+
+		if (_cacheKey && !_replayed && _responseStatus == 200)
+			[[TKAPIResponseCache sharedCache] storeData:data
+				headers:resp.headers forKey:_cacheKey];
+
+		if (!_replayed)
+			[[TKAPIRetryBudget sharedBudget] depositForSuccess];
+
+		if (_successBlock)
+			_successBlock(resp);
+	}
 
 	[self cleanupAndNotify];
 }
 
+- (void)finishWithCachedResponse:(TKAPICachedResponse *)cached
+{
+	_replayed = YES;
+	self.responseStatus = 200;
+
+	NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:_URL
+		statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:cached.headers];
+
+	[self dataTaskDidFinishWithResponse:response data:cached.data];
+}
+
+- (void)dataTaskDidReceiveResponse:(NSURLResponse *)response
+{
+	_response = response;
+
+	if ([response isKindOfClass:[NSHTTPURLResponse class]])
+		self.responseStatus = [(NSHTTPURLResponse *)response statusCode];
+
+	// Only successful responses are streamed, others are processed as a whole
+	_streaming = (self.responseStatus == 200);
+
+	// Streamed responses are never buffered, see the response cache bypass
+	if (!_streaming)
+		_bufferedData = [NSMutableData data];
+}
+
+- (void)dataTaskDidReceiveData:(NSData *)data
+{
+	[_bufferedData appendData:data];
+
+	if (!_streaming) return;
+
+	_streamedLength += data.length;
+
+	if (!_streamFailed && ![_streamCollector appendData:data])
+		_streamFailed = YES;
+}
+
+- (void)dataTaskDidCompleteWithError:(NSError *)error
+{
+	if (error) {
+		[self dataTaskDidFailWithError:error];
+		return;
+	}
+
+	if (!_streaming) {
+		[self dataTaskDidFinishWithResponse:_response data:_bufferedData ?: [NSData data]];
+		return;
+	}
+
+	NSDictionary *dict = (_streamFailed) ? nil : [[_streamCollector finish] parsedDictionary];
+
+	if (!dict) error = [NSError errorWithDomain:NSCocoaErrorDomain
+		code:NSPropertyListReadCorruptError userInfo:nil];
+
+	[self dataTaskDidFinishWithResponse:_response dictionary:dict data:nil error:error];
+}
+
 - (void)dataTaskDidFailWithError:(NSError *)error
 {
+	if (TKAPIErrorIsTransient(error) && [self retryWithServerDelay:-1])
+		return;
+
 #ifdef LOG_API
 	NSTimeInterval duration = -[_startTimestamp timeIntervalSinceNow];
 	NSURLRequest *failingRequest = _task.originalRequest ?: _request;
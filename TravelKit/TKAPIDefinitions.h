@@ -28,9 +28,13 @@ typedef void(^TKAPIFailureBlock)(TKAPIError *);
 @property (nonatomic, copy, readonly) NSDictionary *metadata;
 @property (nonatomic, strong) NSDate *timestamp;
 @property (nonatomic, strong, readonly) id data;
+@property (nonatomic, copy) NSDictionary<NSString *, NSString *> *headers;
 
 - (instancetype)initWithDictionary:(NSDictionary *)dictionary;
 
+// Case-insensitive HTTP header lookup
+- (NSString *)valueForHeaderField:(NSString *)field;
+
 @end
 
 
@@ -0,0 +1,49 @@
+//
+//  TKCanonicalEncoder+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+#import <TravelKit/TKMapRegion.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/**
+ Builder of canonical binary serializations used to derive cache keys of queries.
+
+ Every present value is written as its field tag followed by a type-specific payload,
+ missing values are left out. Unordered string collections are sorted and deduplicated,
+ so equivalent queries always produce the same bytes.
+ */
+@interface TKCanonicalEncoder : NSObject
+
+/// Serialized bytes
+@property (nonatomic, copy, readonly) NSData *data;
+
+/// Hex-encoded 128-bit digest of the serialized bytes
+@property (nonatomic, copy, readonly) NSString *digest;
+
+/// Hex-encoded 128-bit digest of the given bytes
++ (NSString *)digestForData:(NSData *)data;
+
+- (void)encodeUnsignedInteger:(uint64_t)value forField:(UInt8)field;
+- (void)encodeBool:(BOOL)value forField:(UInt8)field;
+- (void)encodeDouble:(double)value forField:(UInt8)field;
+- (void)encodeNumber:(nullable NSNumber *)value forField:(UInt8)field;
+- (void)encodeString:(nullable NSString *)value forField:(UInt8)field;
+- (void)encodeData:(nullable NSData *)value forField:(UInt8)field;
+- (void)encodeDate:(nullable NSDate *)value forField:(UInt8)field;
+- (void)encodeLocation:(nullable CLLocation *)value forField:(UInt8)field;
+- (void)encodeRegion:(nullable TKMapRegion *)value forField:(UInt8)field;
+
+/// Encodes the strings as a sorted set. Empty collections are left out.
+- (void)encodeStringSet:(nullable NSArray<NSString *> *)value forField:(UInt8)field;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,185 @@
+//
+//  TKCanonicalEncoder.m
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <CommonCrypto/CommonDigest.h>
+
+#import "TKCanonicalEncoder+Private.h"
+
+// Length of the digest in bytes
+#define TK_CANONICAL_DIGEST_LENGTH   16
+
+
+@implementation TKCanonicalEncoder
+{
+	NSMutableData *_buffer;
+}
+
++ (NSString *)digestForData:(NSData *)data
+{
+	unsigned char hash[CC_SHA256_DIGEST_LENGTH];
+	CC_SHA256(data.bytes, (CC_LONG)data.length, hash);
+
+	static const char hex[] = "0123456789abcdef";
+	char string[2 * TK_CANONICAL_DIGEST_LENGTH];
+
+	for (NSUInteger i = 0; i < TK_CANONICAL_DIGEST_LENGTH; i++) {
+		string[2*i] = hex[hash[i] >> 4];
+		string[2*i+1] = hex[hash[i] & 0x0F];
+	}
+
+	return [[NSString alloc] initWithBytes:string length:sizeof(string) encoding:NSASCIIStringEncoding];
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+		_buffer = [NSMutableData dataWithCapacity:128];
+
+	return self;
+}
+
+- (NSData *)data
+{
+	return [_buffer copy];
+}
+
+- (NSString *)digest
+{
+	return [self.class digestForData:_buffer];
+}
+
+
+#pragma mark -
+#pragma mark Primitives
+
+
+- (void)appendVarint:(uint64_t)value
+{
+	uint8_t bytes[10];
+	NSUInteger length = 0;
+
+	while (value >= 0x80) {
+		bytes[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+
+	bytes[length++] = (uint8_t)value;
+
+	[_buffer appendBytes:bytes length:length];
+}
+
+- (void)appendDouble:(double)value
+{
+	// Normalise negative zero so equal values produce equal bytes
+	if (value == 0) value = 0;
+
+	uint64_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	bits = CFSwapInt64HostToLittle(bits);
+
+	[_buffer appendBytes:&bits length:sizeof(bits)];
+}
+
+- (void)appendString:(NSString *)value
+{
+	const char *bytes = value.UTF8String ?: "";
+	size_t length = strlen(bytes);
+
+	[self appendVarint:length];
+	[_buffer appendBytes:bytes length:length];
+}
+
+- (void)appendField:(UInt8)field
+{
+	[_buffer appendBytes:&field length:sizeof(field)];
+}
+
+
+#pragma mark -
+#pragma mark Fields
+
+
+- (void)encodeUnsignedInteger:(uint64_t)value forField:(UInt8)field
+{
+	[self appendField:field];
+	[self appendVarint:value];
+}
+
+- (void)encodeBool:(BOOL)value forField:(UInt8)field
+{
+	[self encodeUnsignedInteger:(value) ? 1 : 0 forField:field];
+}
+
+- (void)encodeDouble:(double)value forField:(UInt8)field
+{
+	[self appendField:field];
+	[self appendDouble:value];
+}
+
+- (void)encodeNumber:(NSNumber *)value forField:(UInt8)field
+{
+	if (value) [self encodeDouble:value.doubleValue forField:field];
+}
+
+- (void)encodeString:(NSString *)value forField:(UInt8)field
+{
+	if (!value) return;
+
+	[self appendField:field];
+	[self appendString:value];
+}
+
+- (void)encodeData:(NSData *)value forField:(UInt8)field
+{
+	if (!value) return;
+
+	[self appendField:field];
+	[self appendVarint:value.length];
+	[_buffer appendData:value];
+}
+
+- (void)encodeDate:(NSDate *)value forField:(UInt8)field
+{
+	if (value) [self encodeDouble:value.timeIntervalSince1970 forField:field];
+}
+
+- (void)encodeLocation:(CLLocation *)value forField:(UInt8)field
+{
+	if (!value) return;
+
+	[self appendField:field];
+	[self appendDouble:value.coordinate.latitude];
+	[self appendDouble:value.coordinate.longitude];
+}
+
+- (void)encodeRegion:(TKMapRegion *)value forField:(UInt8)field
+{
+	if (!value) return;
+
+	[self appendField:field];
+	[self appendDouble:value.southWestPoint.coordinate.latitude];
+	[self appendDouble:value.southWestPoint.coordinate.longitude];
+	[self appendDouble:value.northEastPoint.coordinate.latitude];
+	[self appendDouble:value.northEastPoint.coordinate.longitude];
+}
+
+- (void)encodeStringSet:(NSArray<NSString *> *)value forField:(UInt8)field
+{
+	if (!value.count) return;
+
+	NSArray<NSString *> *sorted = [[NSSet setWithArray:value].allObjects
+		sortedArrayUsingSelector:@selector(compare:)];
+
+	[self appendField:field];
+	[self appendVarint:sorted.count];
+
+	for (NSString *string in sorted)
+		[self appendString:string];
+}
+
+@end
@@ -18,6 +18,56 @@ extern NSString * const kTKDatabaseTableFavorites;
 extern NSString * const kTKDatabaseTableTrips;
 extern NSString * const kTKDatabaseTableTripDays;
 extern NSString * const kTKDatabaseTableTripDayItems;
+extern NSString * const kTKDatabaseTablePlacesTiles;
+
+
+/**
+ Row of a query result being enumerated.
+
+ Values are read straight from the underlying statement, the object is reused for all
+ rows of a single query and must not be kept outside of the enumeration.
+ */
+@interface TKDatabaseRow : NSObject
+
+/// Number of columns in the result
+@property (nonatomic, readonly) int columnCount;
+
+/// Index of the column with the given name, `-1` when not present in the result
+- (int)indexOfColumn:(NSString *)columnName;
+
+// Column index accessors
+- (id)valueAtIndex:(int)index; // NSString, NSNumber, NSData or NSNull
+- (BOOL)isNullAtIndex:(int)index;
+- (NSString *)stringAtIndex:(int)index;
+- (NSNumber *)integerNumberAtIndex:(int)index;
+- (long long)integerAtIndex:(int)index;
+- (double)doubleAtIndex:(int)index;
+- (NSData *)dataAtIndex:(int)index;
+
+// Column name accessors, resolved to cached indexes
+- (BOOL)isNullForColumn:(NSString *)columnName;
+- (NSString *)stringForColumn:(NSString *)columnName;
+- (NSNumber *)integerNumberForColumn:(NSString *)columnName;
+- (long long)integerForColumn:(NSString *)columnName;
+- (double)doubleForColumn:(NSString *)columnName;
+- (NSData *)dataForColumn:(NSString *)columnName;
+
+@end
+
+
+/**
+ Running transaction, valid within its block only.
+
+ Statements are performed on the writing connection and queries see the changes
+ not committed yet. Failing updates return `NO` instead of throwing.
+ */
+@interface TKDatabaseTransaction : NSObject
+
+- (void)enumerateQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data usingBlock:(void (^)(TKDatabaseRow *row))block;
+- (BOOL)runUpdate:(NSString *const)query tableName:(NSString *const)tableName data:(NSArray *const)data;
+
+@end
 
 
 @interface TKDatabaseManager : NSObject
@@ -38,15 +88,25 @@ extern NSString * const kTKDatabaseTableTripDayItems;
 /// Check indexes presence
 - (void)checkIndexes;
 
-// SELECT queries
+// SELECT queries -- run on read-only connections alongside the writing one
 - (NSArray *)runQuery:(NSString *const)query;
 - (NSArray *)runQuery:(NSString *const)query tableName:(NSString *const)tableName;
 - (NSArray *)runQuery:(NSString *const)query tableName:(NSString *const)tableName data:(NSArray *const)data;
 
-// INSERT/UPDATE/... queries
+// SELECT queries with rows decoded by the caller, no intermediate dictionaries are built.
+// Objects returned by the decoder are collected, `nil` skips the row.
+- (void)enumerateQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data usingBlock:(void (^)(TKDatabaseRow *row))block;
+- (NSArray *)runQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data decoder:(id (^)(TKDatabaseRow *row))decoder;
+
+// INSERT/UPDATE/... queries -- serialized on a single writing connection
 - (BOOL)runUpdate:(NSString *const)query;
 - (BOOL)runUpdate:(NSString *const)query tableName:(NSString *const)tableName;
 - (BOOL)runUpdate:(NSString *const)query tableName:(NSString *const)tableName data:(NSArray *const)data;
 - (BOOL)runUpdateTransactionWithQueries:(NSArray *const)queries dataArray:(NSArray *const)dataArray;
 
+// Transaction committed when the block succeeds, rolled back when it returns NO or any update fails
+- (BOOL)runTransactionUsingBlock:(BOOL (^)(TKDatabaseTransaction *transaction))block;
+
 @end
@@ -17,13 +17,16 @@
 #import "FMDatabase.h"
 #import "FMDatabaseAdditions.h"
 #import "FMDatabaseQueue.h"
+#import "FMDatabasePool.h"
 #endif
 
+#import <sqlite3.h>
+
 #define NSStringMultiline(...) @#__VA_ARGS__
 
 
 // Database scheme
-NSUInteger const kDatabaseSchemeVersionLatest = 20171026;
+NSUInteger const kDatabaseSchemeVersionLatest = 20261019;
 
 // Table names // ABI-EXPORTED
 //NSString * const kTKDatabaseTablePlaces = @"places";
@@ -35,6 +38,236 @@ NSString * const kTKDatabaseTableFavorites = @"favorites";
 NSString * const kTKDatabaseTableTrips = @"trips";
 NSString * const kTKDatabaseTableTripDays = @"trip_days";
 NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
+NSString * const kTKDatabaseTablePlacesTiles = @"places_tiles";
+
+// Maximal number of concurrently open reading connections
+static const long kTKDatabaseReadersLimit = 4;
+
+// Idle time after the last write before the WAL gets checkpointed
+static const NSTimeInterval kTKDatabaseCheckpointDelay = 2;
+
+// Number of WAL frames above which a complete checkpoint truncates the log
+static const int kTKDatabaseCheckpointTruncateFrames = 4096;
+
+/// Whether the query only reads data and may run on a read-only connection
+static BOOL TKDatabaseQueryIsReading(NSString *query)
+{
+	NSUInteger length = query.length, start = 0;
+	NSCharacterSet *whitespace = [NSCharacterSet whitespaceAndNewlineCharacterSet];
+
+	while (start < length && [whitespace characterIsMember:[query characterAtIndex:start]])
+		start++;
+
+	return [query rangeOfString:@"SELECT" options:NSAnchoredSearch | NSCaseInsensitiveSearch
+		range:NSMakeRange(start, length - start)].location != NSNotFound;
+}
+
+// Number of prepared statements a connection keeps before dropping them all
+static const NSUInteger kTKDatabaseCachedStatementsLimit = 64;
+
+/// Query with the table name filled in, cached per query template
+static NSString *TKDatabaseWorkingQuery(NSString *query, NSString *tableName)
+{
+	static NSCache<NSString *, NSDictionary<NSString *, NSString *> *> *cache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		cache = [NSCache new];
+		cache.countLimit = 128;
+	});
+
+	NSString *tableKey = tableName ?: @"";
+	NSDictionary<NSString *, NSString *> *formatted = [cache objectForKey:query];
+	NSString *workingQuery = formatted[tableKey];
+
+	if (workingQuery) return workingQuery;
+
+	workingQuery = [NSString stringWithFormat:query, tableName];
+
+	NSMutableDictionary<NSString *, NSString *> *updated = [formatted mutableCopy] ?:
+		[NSMutableDictionary dictionaryWithCapacity:1];
+	updated[tableKey] = workingQuery;
+	[cache setObject:updated forKey:query];
+
+	return workingQuery;
+}
+
+
+#pragma mark Database row
+
+
+@interface TKDatabaseRow ()
+
+@property (nonatomic, strong) FMResultSet *resultSet;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *columnIndexes;
+
+- (instancetype)initWithResultSet:(FMResultSet *)resultSet;
+
+@end
+
+
+@implementation TKDatabaseRow
+
+- (instancetype)initWithResultSet:(FMResultSet *)resultSet
+{
+	if (self = [super init])
+	{
+		_resultSet = resultSet;
+		_columnIndexes = [NSMutableDictionary dictionaryWithCapacity:resultSet.columnCount];
+	}
+
+	return self;
+}
+
+- (int)columnCount
+{
+	return _resultSet.columnCount;
+}
+
+- (int)indexOfColumn:(NSString *)columnName
+{
+	NSNumber *index = _columnIndexes[columnName];
+
+	if (!index) {
+		index = @([_resultSet columnIndexForName:columnName]);
+		_columnIndexes[columnName] = index;
+	}
+
+	return index.intValue;
+}
+
+- (id)valueAtIndex:(int)index
+{
+	return ((index >= 0) ? [_resultSet objectForColumnIndex:index] : nil) ?: [NSNull null];
+}
+
+- (BOOL)isNullAtIndex:(int)index
+{
+	return index < 0 || [_resultSet columnIndexIsNull:index];
+}
+
+- (NSString *)stringAtIndex:(int)index
+{
+	return (index >= 0) ? [_resultSet stringForColumnIndex:index] : nil;
+}
+
+- (NSNumber *)integerNumberAtIndex:(int)index
+{
+	return ([self isNullAtIndex:index]) ? nil : @([_resultSet longLongIntForColumnIndex:index]);
+}
+
+- (long long)integerAtIndex:(int)index
+{
+	return (index >= 0) ? [_resultSet longLongIntForColumnIndex:index] : 0;
+}
+
+- (double)doubleAtIndex:(int)index
+{
+	return (index >= 0) ? [_resultSet doubleForColumnIndex:index] : 0;
+}
+
+- (NSData *)dataAtIndex:(int)index
+{
+	return (index >= 0) ? [_resultSet dataForColumnIndex:index] : nil;
+}
+
+- (BOOL)isNullForColumn:(NSString *)columnName
+{
+	return [self isNullAtIndex:[self indexOfColumn:columnName]];
+}
+
+- (NSString *)stringForColumn:(NSString *)columnName
+{
+	return [self stringAtIndex:[self indexOfColumn:columnName]];
+}
+
+- (NSNumber *)integerNumberForColumn:(NSString *)columnName
+{
+	return [self integerNumberAtIndex:[self indexOfColumn:columnName]];
+}
+
+- (long long)integerForColumn:(NSString *)columnName
+{
+	return [self integerAtIndex:[self indexOfColumn:columnName]];
+}
+
+- (double)doubleForColumn:(NSString *)columnName
+{
+	return [self doubleAtIndex:[self indexOfColumn:columnName]];
+}
+
+- (NSData *)dataForColumn:(NSString *)columnName
+{
+	return [self dataAtIndex:[self indexOfColumn:columnName]];
+}
+
+@end
+
+
+/// Enumerates the rows of the query performed on the given connection
+static void TKDatabaseEnumerateQuery(FMDatabase *database, NSString *workingQuery,
+	NSArray *data, void (^block)(TKDatabaseRow *row))
+{
+#ifdef LOG_SQL
+	NSLog(@"[SQL] Query: '%@'  Data: %@", workingQuery, data);
+#endif
+
+	FMResultSet *resultSet = [database executeQuery:workingQuery withArgumentsInArray:data];
+
+	if ([database hadError]) {
+		NSLog(@"[DATABASE] Error when executing query %@: %@", workingQuery, database.lastError);
+		return;
+	}
+
+	// Single row object reads the values of the current row
+	TKDatabaseRow *row = [[TKDatabaseRow alloc] initWithResultSet:resultSet];
+
+	while ([resultSet next])
+		@autoreleasepool { block(row); }
+
+	[resultSet close];
+}
+
+
+#pragma mark Transaction
+
+
+@interface TKDatabaseTransaction ()
+
+@property (nonatomic, strong) FMDatabase *database;
+@property (nonatomic) BOOL failed;
+
+@end
+
+
+@implementation TKDatabaseTransaction
+
+- (void)enumerateQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data usingBlock:(void (^)(TKDatabaseRow *row))block
+{
+	TKDatabaseEnumerateQuery(_database, TKDatabaseWorkingQuery(query, tableName), data, block);
+}
+
+- (BOOL)runUpdate:(NSString *const)query tableName:(NSString *const)tableName data:(NSArray *const)data
+{
+	NSString *workingQuery = TKDatabaseWorkingQuery(query, tableName);
+
+#ifdef LOG_SQL
+	NSLog(@"[SQL] %@ with %@", workingQuery, data);
+#endif
+
+	BOOL isUpdateOk = [_database executeUpdate:workingQuery withArgumentsInArray:data];
+
+	if (!isUpdateOk || [_database hadError]) {
+		NSLog(@"[DATABASE] Error when updating DB with query %@: %@", workingQuery, _database.lastError);
+		_failed = YES;
+		return NO;
+	}
+
+	return YES;
+}
+
+@end
 
 
 #pragma mark Private category
@@ -46,6 +279,12 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 
 @property (atomic) BOOL databaseCreatedRecently;
 @property (nonatomic, strong) FMDatabaseQueue *databaseQueue;
+@property (nonatomic, strong) FMDatabasePool *readersPool;
+@property (nonatomic, strong) dispatch_semaphore_t readersSemaphore;
+
+@property (nonatomic, strong) dispatch_queue_t checkpointQueue;
+@property (atomic) NSUInteger writesGeneration;
+@property (atomic) BOOL checkpointScheduled;
 
 @end
 
@@ -116,12 +355,36 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 			// Throw on error
 			if (!_databaseQueue) @throw @"Database initialization error";
 
+			// Keep prepared statements of repeated queries
+			[_databaseQueue inDatabase:^(FMDatabase *database){
+				database.shouldCacheStatements = YES;
+			}];
+
 			// Check consistency
 			[self checkConsistency];
+
+			// Prepare readers
+			[self initializeReaders];
 		}
 	}
 }
 
+- (void)initializeReaders
+{
+	// Readers may only run alongside the writer in the WAL mode,
+	// reads are performed on the writing connection otherwise
+	NSString *journalMode = [[[[self runQuery:@"PRAGMA journal_mode;"] lastObject]
+		[@"journal_mode"] parsedString] lowercaseString];
+
+	if (![journalMode isEqualToString:@"wal"]) return;
+
+	_readersPool = [FMDatabasePool databasePoolWithPath:[TKDatabaseManager databasePath]
+		flags:SQLITE_OPEN_READONLY];
+	_readersPool.delegate = self;
+	_readersSemaphore = dispatch_semaphore_create(kTKDatabaseReadersLimit);
+	_checkpointQueue = dispatch_queue_create("TravelKit.DatabaseCheckpoint", DISPATCH_QUEUE_SERIAL);
+}
+
 
 #pragma mark -
 #pragma mark Version checking
@@ -137,7 +400,7 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 {
 	NSString *userVersionQuery = [NSString stringWithFormat:
 		@"PRAGMA user_version = %tu;", databaseVersion];
-	[self runQuery:userVersionQuery tableName:nil data:nil];
+	[self runUpdate:userVersionQuery tableName:nil data:nil];
 }
 
 
@@ -150,7 +413,10 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 	//////////////////////////////////
 	// Set journal mode
 
-	[self runQuery:@"PRAGMA journal_mode = 'TRUNCATE';" tableName:nil data:nil];
+	// Write-ahead log lets reading connections run alongside the writing one,
+	// syncing on checkpoints only is safe in this mode
+	[self runQuery:@"PRAGMA journal_mode = 'WAL';" tableName:nil data:nil];
+	[self runQuery:@"PRAGMA synchronous = 'NORMAL';" tableName:nil data:nil];
 
 	//////////////////////////////////
 	// Check Database scheme
@@ -172,6 +438,20 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 //	[self runUpdate:@"CREATE INDEX IF NOT EXISTS index_name ON %@ (quadkey ASC);"
 //		  tableName:... data:nil];
 
+	// Trip lists
+	[self runUpdate:@"CREATE INDEX IF NOT EXISTS trips_deleted_starts_on "
+	 "ON %@ (deleted ASC, starts_on ASC);" tableName:kTKDatabaseTableTrips];
+	[self runUpdate:@"CREATE INDEX IF NOT EXISTS trips_ends_on "
+	 "ON %@ (ends_on ASC);" tableName:kTKDatabaseTableTrips];
+	[self runUpdate:@"CREATE INDEX IF NOT EXISTS trips_changed "
+	 "ON %@ (changed ASC);" tableName:kTKDatabaseTableTrips];
+	[self runUpdate:@"CREATE INDEX IF NOT EXISTS trips_updated_at "
+	 "ON %@ (updated_at DESC);" tableName:kTKDatabaseTableTrips];
+
+	// Lookups of Trips containing a place
+	[self runUpdate:@"CREATE INDEX IF NOT EXISTS trip_day_items_item_id "
+	 "ON %@ (item_id ASC);" tableName:kTKDatabaseTableTripDayItems];
+
 //		NSString *sql = NSStringMultiline(
 //
 //CREATE INDEX IF NOT EXISTS medium_type ON "medium" ("type" ASC);
@@ -252,8 +532,33 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 
 	// Missing Route ID attribute
 	if (currentScheme < 20181024) {
-		[self runUpdate:@"ALTER TABLE %@ ADD transport_route_id text;"
-			tableName:kTKDatabaseTableTripDayItems];
+		if (![self checkExistenceOfColumn:@"transport_route_id" inTable:kTKDatabaseTableTripDayItems])
+			[self runUpdate:@"ALTER TABLE %@ ADD transport_route_id text;"
+				tableName:kTKDatabaseTableTripDayItems];
+	}
+
+	// Persistent places tile cache
+	if (currentScheme < 20261018) {
+
+		[self runUpdate:@"CREATE TABLE IF NOT EXISTS %@ (key text PRIMARY KEY NOT NULL, "
+		 "etag text, fetched_at real NOT NULL, expires_at real NOT NULL, accessed_at real NOT NULL, "
+		 "complete integer NOT NULL DEFAULT 0, size integer NOT NULL, data blob NOT NULL);" tableName:kTKDatabaseTablePlacesTiles];
+
+		[self runUpdate:@"CREATE INDEX IF NOT EXISTS places_tiles_accessed_at "
+		 "ON %@ (accessed_at ASC);" tableName:kTKDatabaseTablePlacesTiles];
+	}
+
+	// Stored Trip end dates, comparable flags
+	if (currentScheme < 20261019) {
+
+		if (![self checkExistenceOfColumn:@"ends_on" inTable:kTKDatabaseTableTrips])
+			[self runUpdate:@"ALTER TABLE %@ ADD ends_on text;" tableName:kTKDatabaseTableTrips];
+
+		[self runUpdate:@"UPDATE %@ SET ends_on = DATE(starts_on, '+' || (MAX(days, 1) - 1) || ' days') "
+		 "WHERE starts_on IS NOT NULL;" tableName:kTKDatabaseTableTrips];
+
+		[self runUpdate:@"UPDATE %@ SET deleted = 0 WHERE deleted IS NULL;" tableName:kTKDatabaseTableTrips];
+		[self runUpdate:@"UPDATE %@ SET changed = 0 WHERE changed IS NULL;" tableName:kTKDatabaseTableTrips];
 	}
 
 	//////////////
@@ -263,6 +568,105 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 }
 
 
+#pragma mark -
+#pragma mark Connections
+
+
+- (void)inReadingDatabase:(void (^)(FMDatabase *database))block
+{
+	FMDatabasePool *readers = _readersPool;
+
+	if (!readers) {
+		[_databaseQueue inDatabase:block];
+		return;
+	}
+
+	// Pool refuses to hand out a connection over its limit,
+	// throttle the readers here instead
+	dispatch_semaphore_wait(_readersSemaphore, DISPATCH_TIME_FOREVER);
+	[readers inDatabase:block];
+	dispatch_semaphore_signal(_readersSemaphore);
+}
+
+- (void)inDatabaseForQuery:(NSString *)query block:(void (^)(FMDatabase *database))block
+{
+	// Statements modifying the data are still occasionally passed as queries
+	if (!TKDatabaseQueryIsReading(query)) {
+		[_databaseQueue inDatabase:block];
+		[self scheduleCheckpoint];
+		return;
+	}
+
+	[self inReadingDatabase:block];
+}
+
+- (void)databasePool:(__unused FMDatabasePool *)pool didAddDatabase:(FMDatabase *)database
+{
+	database.shouldCacheStatements = YES;
+}
+
+- (void)trimCachedStatementsOfDatabase:(FMDatabase *)database
+{
+	// Queries built with inlined values would grow the cache without bounds
+	if (database.cachedStatements.count > kTKDatabaseCachedStatementsLimit)
+		[database clearCachedStatements];
+}
+
+
+#pragma mark -
+#pragma mark Checkpointing
+
+
+- (void)scheduleCheckpoint
+{
+	if (!_checkpointQueue) return;
+
+	self.writesGeneration++;
+
+	if (self.checkpointScheduled) return;
+	self.checkpointScheduled = YES;
+
+	[self scheduleCheckpointForGeneration:self.writesGeneration];
+}
+
+- (void)scheduleCheckpointForGeneration:(NSUInteger)generation
+{
+	dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kTKDatabaseCheckpointDelay * NSEC_PER_SEC)),
+	  _checkpointQueue, ^{
+
+		// Postpone while the writes keep coming
+		NSUInteger current = self.writesGeneration;
+		if (current != generation) {
+			[self scheduleCheckpointForGeneration:current];
+			return;
+		}
+
+		self.checkpointScheduled = NO;
+
+		[self checkpoint];
+	});
+}
+
+- (void)checkpoint
+{
+	[_databaseQueue inDatabase:^(FMDatabase *database){
+
+		int logFrames = 0, checkpointedFrames = 0;
+		NSError *error = nil;
+
+		if (![database checkpoint:FMDBCheckpointModePassive name:nil
+		  logFrameCount:&logFrames checkpointCount:&checkpointedFrames error:&error]) {
+			NSLog(@"[DATABASE] Checkpoint failed: %@", error);
+			return;
+		}
+
+		// Reclaim the space of a grown log once it's fully transferred
+		if (logFrames > kTKDatabaseCheckpointTruncateFrames && checkpointedFrames == logFrames)
+			[database checkpoint:FMDBCheckpointModeTruncate error:nil];
+	}];
+}
+
+
 #pragma mark -
 #pragma mark Database methods
 
@@ -280,7 +684,7 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 - (NSArray *)runQuery:(NSString *const)query tableName:(NSString *const)tableName data:(NSArray *const)data
 {
 	// Fill in a table name
-	NSString *workingQuery = [NSString stringWithFormat:query, tableName];
+	NSString *workingQuery = TKDatabaseWorkingQuery(query, tableName);
 
 #ifdef LOG_SQL
 	NSLog(@"[SQL] Query: '%@'  Data: %@", workingQuery, data);
@@ -289,7 +693,7 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 	__block NSMutableArray *results = [NSMutableArray array];
 	__block NSError *error = nil;
 
-	[_databaseQueue inDatabase:^(FMDatabase *database){
+	[self inDatabaseForQuery:workingQuery block:^(FMDatabase *database){
 
 		@autoreleasepool {
 
@@ -309,6 +713,7 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 			[resultSet close];
 			resultSet = nil;
 
+			[self trimCachedStatementsOfDatabase:database];
 		}
 
 	}];
@@ -316,6 +721,31 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 	return results;
 }
 
+- (void)enumerateQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data usingBlock:(void (^)(TKDatabaseRow *row))block
+{
+	// Fill in a table name
+	NSString *workingQuery = TKDatabaseWorkingQuery(query, tableName);
+
+	[self inDatabaseForQuery:workingQuery block:^(FMDatabase *database){
+		TKDatabaseEnumerateQuery(database, workingQuery, data, block);
+		[self trimCachedStatementsOfDatabase:database];
+	}];
+}
+
+- (NSArray *)runQuery:(NSString *const)query tableName:(NSString *const)tableName
+	data:(NSArray *const)data decoder:(id (^)(TKDatabaseRow *row))decoder
+{
+	NSMutableArray *results = [NSMutableArray array];
+
+	[self enumerateQuery:query tableName:tableName data:data usingBlock:^(TKDatabaseRow *row) {
+		id object = decoder(row);
+		if (object) [results addObject:object];
+	}];
+
+	return results;
+}
+
 - (BOOL)runUpdate:(NSString *const)query
 {
 	return [self runUpdate:query tableName:nil data:nil];
@@ -330,7 +760,7 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 {
 
 	// Fill in a table name
-	NSString *workingQuery = [NSString stringWithFormat:query, tableName];
+	NSString *workingQuery = TKDatabaseWorkingQuery(query, tableName);
 
 #ifdef LOG_SQL
 	NSLog(@"[SQL] %@ with %@", workingQuery, data);
@@ -346,8 +776,12 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 		if ([database hadError]) error = database.lastError;
 		changes = database.changes;
 
+		[self trimCachedStatementsOfDatabase:database];
+
 	}];
 
+	if (isUpdateOk) [self scheduleCheckpoint];
+
 	if (error) @throw @"Database update error";
 
 	return isUpdateOk;
@@ -381,8 +815,34 @@ NSString * const kTKDatabaseTableTripDayItems = @"trip_day_items";
 			index++;
 		}
 
+		[self trimCachedStatementsOfDatabase:database];
+
+	}];
+
+	if (!error) [self scheduleCheckpoint];
+
+	return isUpdateOk;
+}
+
+- (BOOL)runTransactionUsingBlock:(BOOL (^)(TKDatabaseTransaction *transaction))block
+{
+	__block BOOL isUpdateOk = YES;
+
+	[_databaseQueue inTransaction:^(FMDatabase *database, BOOL *rollback){
+
+		TKDatabaseTransaction *transaction = [TKDatabaseTransaction new];
+		transaction.database = database;
+
+		isUpdateOk = block(transaction) && !transaction.failed;
+
+		if (!isUpdateOk) *rollback = YES;
+
+		[self trimCachedStatementsOfDatabase:database];
+
 	}];
 
+	if (isUpdateOk) [self scheduleCheckpoint];
+
 	return isUpdateOk;
 }
 
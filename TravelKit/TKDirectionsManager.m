@@ -78,17 +78,25 @@
 		return;
 	}
 
-	[_directionsQueue addOperationWithBlock:^{
-		[[[TKAPIRequest alloc] initAsDirectionsRequestForQuery:query success:^(TKDirectionsSet *directionsSet) {
+	// Attach to a pending request for the same locations
+	[[TKAPIRequestCoalescer sharedCoalescer] performFlightWithKey:[@"directions|" stringByAppendingString:cacheKey]
+	  start:^(TKAPIFlightCompletion finish) {
 
-			if (directionsSet)
-				[_directionsCache setObject:directionsSet forKey:cacheKey];
+		[_directionsQueue addOperationWithBlock:^{
+			[[[TKAPIRequest alloc] initAsDirectionsRequestForQuery:query success:^(TKDirectionsSet *directionsSet) {
 
-			if (completion) completion(directionsSet);
+				if (directionsSet)
+					[_directionsCache setObject:directionsSet forKey:cacheKey];
 
-		} failure:^(TKAPIError *__unused e) {
-			if (completion) completion(nil);
-		}] silentStart];
+				finish(directionsSet, nil);
+
+			} failure:^(TKAPIError *e) {
+				finish(nil, e);
+			}] silentStart];
+		}];
+
+	} completion:^(TKDirectionsSet *directionsSet, TKAPIError *__unused e) {
+		if (completion) completion(directionsSet);
 	}];
 }
 
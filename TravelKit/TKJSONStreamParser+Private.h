@@ -0,0 +1,80 @@
+//
+//  TKJSONStreamParser+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@class TKJSONStreamParser;
+
+/// Receiver of events emitted while parsing the JSON stream.
+@protocol TKJSONStreamParserDelegate <NSObject>
+
+@required
+- (void)parserDidStartObject:(TKJSONStreamParser *)parser;
+- (void)parserDidEndObject:(TKJSONStreamParser *)parser;
+- (void)parserDidStartArray:(TKJSONStreamParser *)parser;
+- (void)parserDidEndArray:(TKJSONStreamParser *)parser;
+- (void)parser:(TKJSONStreamParser *)parser didFindKey:(NSString *)key;
+
+/// Scalar value -- `NSString`, `NSNumber` or `NSNull`.
+- (void)parser:(TKJSONStreamParser *)parser didFindValue:(id)value;
+
+@end
+
+
+/**
+ Incremental event-driven JSON parser.
+
+ Data may be passed in chunks of any size as they arrive, tokens split between chunks
+ are buffered until complete. Once a malformed input is found, the parser stops
+ emitting events and all further calls fail.
+ */
+@interface TKJSONStreamParser : NSObject
+
+@property (nonatomic, weak, nullable) id<TKJSONStreamParserDelegate> delegate;
+
+/// Parses the next chunk of data. Returns `NO` on malformed input.
+- (BOOL)parseData:(NSData *)data;
+
+/// Finishes parsing. Returns `NO` when the input is malformed or incomplete.
+- (BOOL)finish;
+
+@end
+
+
+/**
+ Builder of a JSON object graph from a stream, handing elements of a single array
+ over one by one instead of collecting them.
+
+ Elements of the array found at the given key path are passed to the item handler
+ as soon as they are complete and dropped right after, the array itself stays empty
+ in the resulting graph. Peak memory is thus given by the size of a single element
+ instead of the whole response.
+ */
+@interface TKJSONStreamCollector : NSObject
+
+- (instancetype)initWithItemsPath:(NSArray<NSString *> *)itemsPath itemHandler:(nullable void (^)(id item))itemHandler;
+
+/// Variant forwarding the parser events of the array elements to the given delegate
+/// instead of building them, letting it decode the elements straight into its own model.
+- (instancetype)initWithItemsPath:(NSArray<NSString *> *)itemsPath itemsDelegate:(id<TKJSONStreamParserDelegate>)itemsDelegate;
+
+/// Disqualified initializer
++ (instancetype)new  UNAVAILABLE_ATTRIBUTE;
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/// Parses the next chunk of data. Returns `NO` on malformed input.
+- (BOOL)appendData:(NSData *)data;
+
+/// Finishes parsing and returns the root object, `nil` when the input is malformed or incomplete.
+- (nullable id)finish;
+
+@end
+
+NS_ASSUME_NONNULL_END
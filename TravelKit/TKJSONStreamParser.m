@@ -0,0 +1,593 @@
+//
+//  TKJSONStreamParser.m
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import "TKJSONStreamParser+Private.h"
+
+// Maximal supported nesting of containers
+#define TK_JSON_MAX_DEPTH   512
+
+typedef NS_ENUM(UInt8, TKJSONExpectation) {
+	TKJSONExpectValue = 0,
+	TKJSONExpectValueOrArrayEnd,
+	TKJSONExpectKeyOrObjectEnd,
+	TKJSONExpectKey,
+	TKJSONExpectColon,
+	TKJSONExpectCommaOrEnd,
+	TKJSONExpectNothing,
+};
+
+typedef NS_ENUM(UInt8, TKJSONToken) {
+	TKJSONTokenNone = 0,
+	TKJSONTokenString,
+	TKJSONTokenKey,
+	TKJSONTokenNumber,
+	TKJSONTokenLiteral,
+};
+
+static inline BOOL TKJSONIsNumberByte(uint8_t c)
+{
+	return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static inline int TKJSONHexValue(uint8_t c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/// Reads 4 hex digits of an `\u` escape, returns `-1` when malformed
+static int32_t TKJSONReadUnicodeEscape(const uint8_t *bytes, NSUInteger length, NSUInteger i)
+{
+	if (i + 4 > length) return -1;
+
+	int32_t value = 0;
+
+	for (NSUInteger k = i; k < i + 4; k++) {
+		int digit = TKJSONHexValue(bytes[k]);
+		if (digit < 0) return -1;
+		value = (value << 4) | digit;
+	}
+
+	return value;
+}
+
+static void TKJSONAppendCodePoint(NSMutableData *data, uint32_t cp)
+{
+	uint8_t utf[4];
+	NSUInteger length = 0;
+
+	if (cp < 0x80) {
+		utf[length++] = (uint8_t)cp;
+	}
+	else if (cp < 0x800) {
+		utf[length++] = (uint8_t)(0xC0 | (cp >> 6));
+		utf[length++] = (uint8_t)(0x80 | (cp & 0x3F));
+	}
+	else if (cp < 0x10000) {
+		utf[length++] = (uint8_t)(0xE0 | (cp >> 12));
+		utf[length++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+		utf[length++] = (uint8_t)(0x80 | (cp & 0x3F));
+	}
+	else {
+		utf[length++] = (uint8_t)(0xF0 | (cp >> 18));
+		utf[length++] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+		utf[length++] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+		utf[length++] = (uint8_t)(0x80 | (cp & 0x3F));
+	}
+
+	[data appendBytes:utf length:length];
+}
+
+/// Decodes raw string token bytes containing escape sequences
+static NSString *TKJSONUnescapedString(const uint8_t *bytes, NSUInteger length)
+{
+	NSMutableData *decoded = [NSMutableData dataWithCapacity:length];
+
+	NSUInteger i = 0;
+
+	while (i < length)
+	{
+		NSUInteger run = i;
+		while (run < length && bytes[run] != '\\') run++;
+		if (run > i) [decoded appendBytes:bytes + i length:run - i];
+		if (run == length) break;
+
+		// Escape sequence
+		i = run + 1;
+		if (i >= length) return nil;
+
+		uint8_t c = bytes[i++], plain = 0;
+
+		switch (c) {
+			case '"':  plain = '"'; break;
+			case '\\': plain = '\\'; break;
+			case '/':  plain = '/'; break;
+			case 'b':  plain = '\b'; break;
+			case 'f':  plain = '\f'; break;
+			case 'n':  plain = '\n'; break;
+			case 'r':  plain = '\r'; break;
+			case 't':  plain = '\t'; break;
+			case 'u': {
+
+				int32_t cp = TKJSONReadUnicodeEscape(bytes, length, i);
+				if (cp < 0) return nil;
+				i += 4;
+
+				// Combine surrogate pairs, lone surrogates are replaced
+				if (cp >= 0xD800 && cp <= 0xDBFF)
+				{
+					int32_t low = (i + 1 < length && bytes[i] == '\\' && bytes[i+1] == 'u') ?
+						TKJSONReadUnicodeEscape(bytes, length, i + 2) : -1;
+
+					if (low >= 0xDC00 && low <= 0xDFFF) {
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						i += 6;
+					}
+					else cp = 0xFFFD;
+				}
+				else if (cp >= 0xDC00 && cp <= 0xDFFF) cp = 0xFFFD;
+
+				TKJSONAppendCodePoint(decoded, (uint32_t)cp);
+				continue;
+			}
+			default: return nil;
+		}
+
+		[decoded appendBytes:&plain length:1];
+	}
+
+	return [[NSString alloc] initWithData:decoded encoding:NSUTF8StringEncoding];
+}
+
+
+#pragma mark - Stream parser -
+
+
+@implementation TKJSONStreamParser
+{
+	UInt8 _stack[TK_JSON_MAX_DEPTH];
+	NSUInteger _depth;
+	TKJSONExpectation _expect;
+	TKJSONToken _token;
+	NSMutableData *_tokenBuffer;
+	BOOL _escaped;
+	BOOL _tokenHasEscapes;
+	BOOL _failed;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_tokenBuffer = [NSMutableData dataWithCapacity:256];
+		_expect = TKJSONExpectValue;
+	}
+
+	return self;
+}
+
+- (BOOL)parseData:(NSData *)data
+{
+	if (_failed) return NO;
+
+	const uint8_t *bytes = data.bytes;
+	NSUInteger length = data.length;
+
+	id<TKJSONStreamParserDelegate> delegate = _delegate;
+
+	for (NSUInteger i = 0; i < length; i++)
+	{
+		uint8_t c = bytes[i];
+
+		// String tokens, copied in runs up to the next special character
+
+		if (_token == TKJSONTokenString || _token == TKJSONTokenKey)
+		{
+			if (_escaped) {
+				[_tokenBuffer appendBytes:&c length:1];
+				_escaped = NO;
+				continue;
+			}
+
+			NSUInteger run = i;
+			while (run < length && bytes[run] != '"' && bytes[run] != '\\' && bytes[run] >= 0x20) run++;
+			if (run > i) [_tokenBuffer appendBytes:bytes + i length:run - i];
+			if (run == length) break;
+
+			i = run; c = bytes[i];
+
+			if (c == '\\') {
+				[_tokenBuffer appendBytes:&c length:1];
+				_escaped = _tokenHasEscapes = YES;
+				continue;
+			}
+
+			if (c == '"') {
+				if (![self finishToken]) return [self fail];
+				continue;
+			}
+
+			// Unescaped control character
+			return [self fail];
+		}
+
+		// Number and literal tokens end with the first byte not belonging to them
+
+		if (_token == TKJSONTokenNumber || _token == TKJSONTokenLiteral)
+		{
+			BOOL belongs = (_token == TKJSONTokenNumber) ?
+				TKJSONIsNumberByte(c) : (c >= 'a' && c <= 'z');
+
+			if (belongs) {
+				[_tokenBuffer appendBytes:&c length:1];
+				continue;
+			}
+
+			if (![self finishToken]) return [self fail];
+		}
+
+		BOOL expectsValue = _expect == TKJSONExpectValue || _expect == TKJSONExpectValueOrArrayEnd;
+		UInt8 top = (_depth) ? _stack[_depth-1] : 0;
+
+		switch (c)
+		{
+			case ' ': case '\t': case '\n': case '\r':
+				break;
+
+			case '{':
+			case '[':
+				if (!expectsValue || _depth >= TK_JSON_MAX_DEPTH) return [self fail];
+				_stack[_depth++] = c;
+				if (c == '{') {
+					_expect = TKJSONExpectKeyOrObjectEnd;
+					[delegate parserDidStartObject:self];
+				} else {
+					_expect = TKJSONExpectValueOrArrayEnd;
+					[delegate parserDidStartArray:self];
+				}
+				break;
+
+			case '}':
+				if (top != '{' || (_expect != TKJSONExpectKeyOrObjectEnd &&
+				    _expect != TKJSONExpectCommaOrEnd)) return [self fail];
+				_depth--;
+				[delegate parserDidEndObject:self];
+				[self didCompleteValue];
+				break;
+
+			case ']':
+				if (top != '[' || (_expect != TKJSONExpectValueOrArrayEnd &&
+				    _expect != TKJSONExpectCommaOrEnd)) return [self fail];
+				_depth--;
+				[delegate parserDidEndArray:self];
+				[self didCompleteValue];
+				break;
+
+			case ':':
+				if (_expect != TKJSONExpectColon) return [self fail];
+				_expect = TKJSONExpectValue;
+				break;
+
+			case ',':
+				if (_expect != TKJSONExpectCommaOrEnd) return [self fail];
+				_expect = (top == '{') ? TKJSONExpectKey : TKJSONExpectValue;
+				break;
+
+			case '"':
+				if (_expect == TKJSONExpectKey || _expect == TKJSONExpectKeyOrObjectEnd)
+					_token = TKJSONTokenKey;
+				else if (expectsValue) _token = TKJSONTokenString;
+				else return [self fail];
+				[self beginToken];
+				break;
+
+			default:
+				if (!expectsValue) return [self fail];
+				if (c == '-' || (c >= '0' && c <= '9')) _token = TKJSONTokenNumber;
+				else if (c == 't' || c == 'f' || c == 'n') _token = TKJSONTokenLiteral;
+				else return [self fail];
+				[self beginToken];
+				[_tokenBuffer appendBytes:&c length:1];
+				break;
+		}
+	}
+
+	return YES;
+}
+
+- (BOOL)finish
+{
+	if (_failed) return NO;
+
+	// Root scalars are only terminated by the end of the stream
+	if ((_token == TKJSONTokenNumber || _token == TKJSONTokenLiteral) && ![self finishToken])
+		return [self fail];
+
+	return _token == TKJSONTokenNone && !_depth && _expect == TKJSONExpectNothing;
+}
+
+
+#pragma mark - Tokens
+
+
+- (void)beginToken
+{
+	_tokenBuffer.length = 0;
+	_escaped = _tokenHasEscapes = NO;
+}
+
+- (BOOL)finishToken
+{
+	TKJSONToken token = _token;
+	_token = TKJSONTokenNone;
+
+	const uint8_t *bytes = _tokenBuffer.bytes;
+	NSUInteger length = _tokenBuffer.length;
+
+	id value = nil;
+
+	if (token == TKJSONTokenString || token == TKJSONTokenKey)
+	{
+		value = (_tokenHasEscapes) ? TKJSONUnescapedString(bytes, length) :
+			[[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+	}
+	else if (token == TKJSONTokenNumber)
+	{
+		char number[64];
+		if (length >= sizeof(number)) return NO;
+
+		memcpy(number, bytes, length);
+		number[length] = '\0';
+
+		char *end = NULL;
+		BOOL integral = !memchr(number, '.', length) && !memchr(number, 'e', length) && !memchr(number, 'E', length);
+
+		if (integral) {
+			errno = 0;
+			long long integer = strtoll(number, &end, 10);
+			if (errno == 0 && end == number + length) value = @(integer);
+		}
+
+		if (!value) {
+			double real = strtod(number, &end);
+			if (end == number + length) value = @(real);
+		}
+	}
+	else if (token == TKJSONTokenLiteral)
+	{
+		if (length == 4 && !memcmp(bytes, "true", 4)) value = @YES;
+		else if (length == 5 && !memcmp(bytes, "false", 5)) value = @NO;
+		else if (length == 4 && !memcmp(bytes, "null", 4)) value = [NSNull null];
+	}
+
+	if (!value) return NO;
+
+	if (token == TKJSONTokenKey) {
+		_expect = TKJSONExpectColon;
+		[_delegate parser:self didFindKey:value];
+	}
+	else {
+		[_delegate parser:self didFindValue:value];
+		[self didCompleteValue];
+	}
+
+	return YES;
+}
+
+- (void)didCompleteValue
+{
+	_expect = (_depth) ? TKJSONExpectCommaOrEnd : TKJSONExpectNothing;
+}
+
+- (BOOL)fail
+{
+	_failed = YES;
+	_token = TKJSONTokenNone;
+	_tokenBuffer.length = 0;
+	return NO;
+}
+
+@end
+
+
+#pragma mark - Stream collector -
+
+
+@interface TKJSONStreamCollector () <TKJSONStreamParserDelegate>
+@end
+
+@implementation TKJSONStreamCollector
+{
+	TKJSONStreamParser *_parser;
+	NSArray<NSString *> *_itemsPath;
+	void (^_itemHandler)(id);
+	id<TKJSONStreamParserDelegate> _itemsDelegate;
+	NSUInteger _forwardedDepth;
+
+	NSMutableArray *_containers;
+	NSMutableArray *_keys;
+	NSUInteger _itemsDepth;
+	id _root;
+}
+
+- (instancetype)initWithItemsPath:(NSArray<NSString *> *)itemsPath itemHandler:(void (^)(id))itemHandler
+{
+	if (self = [super init])
+	{
+		_parser = [TKJSONStreamParser new];
+		_parser.delegate = self;
+		_itemsPath = [itemsPath copy];
+		_itemHandler = [itemHandler copy];
+		_containers = [NSMutableArray arrayWithCapacity:8];
+		_keys = [NSMutableArray arrayWithCapacity:8];
+	}
+
+	return self;
+}
+
+- (instancetype)initWithItemsPath:(NSArray<NSString *> *)itemsPath itemsDelegate:(id<TKJSONStreamParserDelegate>)itemsDelegate
+{
+	if (self = [self initWithItemsPath:itemsPath itemHandler:nil])
+	{
+		_itemsDelegate = itemsDelegate;
+	}
+
+	return self;
+}
+
+- (BOOL)appendData:(NSData *)data
+{
+	return [_parser parseData:data];
+}
+
+- (id)finish
+{
+	return ([_parser finish]) ? _root : nil;
+}
+
+
+#pragma mark - Graph building
+
+
+- (BOOL)isAtItemsPath
+{
+	NSUInteger count = _itemsPath.count;
+
+	if (_itemsDepth || _containers.count != count) return NO;
+
+	for (NSUInteger i = 0; i < count; i++)
+		if (![_containers[i] isKindOfClass:[NSMutableDictionary class]] ||
+		    ![_keys[i] isEqual:_itemsPath[i]]) return NO;
+
+	return YES;
+}
+
+- (void)addValue:(id)value
+{
+	if (!_containers.count) {
+		_root = value;
+		return;
+	}
+
+	// Elements of the streamed array are handed over instead of collected
+	if (_itemsDepth == _containers.count) {
+		@autoreleasepool {
+			if (_itemHandler) _itemHandler(value);
+		}
+		return;
+	}
+
+	id parent = _containers.lastObject;
+
+	if ([parent isKindOfClass:[NSMutableArray class]])
+		[(NSMutableArray *)parent addObject:value];
+	else if ([_keys.lastObject isKindOfClass:[NSString class]])
+		((NSMutableDictionary *)parent)[_keys.lastObject] = value;
+}
+
+- (void)pushContainer:(id)container
+{
+	BOOL streamed = [container isKindOfClass:[NSMutableArray class]] && [self isAtItemsPath];
+
+	[_containers addObject:container];
+	[_keys addObject:[NSNull null]];
+
+	if (streamed) _itemsDepth = _containers.count;
+}
+
+- (void)popContainer
+{
+	id container = _containers.lastObject;
+
+	if (_itemsDepth == _containers.count)
+		_itemsDepth = 0;
+
+	[_containers removeLastObject];
+	[_keys removeLastObject];
+
+	[self addValue:container];
+}
+
+
+#pragma mark - Parser delegate
+
+
+/// States whether events are forwarded to the items delegate
+- (BOOL)forwarding
+{
+	return _itemsDelegate && _itemsDepth && _itemsDepth == _containers.count;
+}
+
+- (void)parserDidStartObject:(TKJSONStreamParser *)parser
+{
+	if ([self forwarding]) {
+		_forwardedDepth++;
+		[_itemsDelegate parserDidStartObject:parser];
+		return;
+	}
+
+	[self pushContainer:[NSMutableDictionary dictionaryWithCapacity:16]];
+}
+
+- (void)parserDidEndObject:(TKJSONStreamParser *)parser
+{
+	if ([self forwarding]) {
+		_forwardedDepth--;
+		[_itemsDelegate parserDidEndObject:parser];
+		return;
+	}
+
+	[self popContainer];
+}
+
+- (void)parserDidStartArray:(TKJSONStreamParser *)parser
+{
+	if ([self forwarding]) {
+		_forwardedDepth++;
+		[_itemsDelegate parserDidStartArray:parser];
+		return;
+	}
+
+	[self pushContainer:[NSMutableArray arrayWithCapacity:8]];
+}
+
+- (void)parserDidEndArray:(TKJSONStreamParser *)parser
+{
+	// End of the streamed array itself is not forwarded
+	if ([self forwarding] && _forwardedDepth) {
+		_forwardedDepth--;
+		[_itemsDelegate parserDidEndArray:parser];
+		return;
+	}
+
+	[self popContainer];
+}
+
+- (void)parser:(TKJSONStreamParser *)parser didFindKey:(NSString *)key
+{
+	if ([self forwarding]) {
+		[_itemsDelegate parser:parser didFindKey:key];
+		return;
+	}
+
+	_keys[_keys.count-1] = key;
+}
+
+- (void)parser:(TKJSONStreamParser *)parser didFindValue:(id)value
+{
+	if ([self forwarding]) {
+		[_itemsDelegate parser:parser didFindValue:value];
+		return;
+	}
+
+	[self addValue:value];
+}
+
+@end
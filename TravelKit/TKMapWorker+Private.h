@@ -0,0 +1,138 @@
+//
+//  TKMapWorker+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+#import <MapKit/MapKit.h>
+
+#import <TravelKit/TKMapWorker.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+
+///-----------------------------------------------------------------------------
+#pragma mark - Tile definitions
+///-----------------------------------------------------------------------------
+
+
+/// Maximal supported detail level of a quad key.
+#define TK_QUADKEY_MAX_LEVEL   23
+
+/// Tile coordinate in the Mercator tile grid of a given detail level.
+typedef struct {
+	int64_t x;
+	int64_t y;
+} TKTilePoint;
+
+
+///-----------------------------------------------------------------------------
+#pragma mark - Quad key engine
+///-----------------------------------------------------------------------------
+
+
+/// Tile point containing the given coordinate on the given detail level.
+FOUNDATION_EXPORT TKTilePoint TKTilePointForCoordinate(CLLocationCoordinate2D coordinate, UInt8 level);
+
+/// Bit-interleaved quad key bits of the given tile point. Each quad key digit
+/// takes 2 bits, the most significant digit being the top-most one.
+FOUNDATION_EXPORT uint64_t TKQuadKeyBitsForTilePoint(TKTilePoint tilePoint);
+
+/// Quad key bits of the given coordinate on the given detail level.
+FOUNDATION_EXPORT uint64_t TKQuadKeyBitsForCoordinate(CLLocationCoordinate2D coordinate, UInt8 level);
+
+/// Batch variant filling `keys` with quad key bits of `count` given coordinates.
+FOUNDATION_EXPORT void TKQuadKeyBitsForCoordinates(const CLLocationCoordinate2D *coordinates,
+	NSUInteger count, UInt8 level, uint64_t *keys);
+
+/**
+ Exact set of tiles covering the given region on the given detail level.
+
+ Tiles are emitted row by row from south to north, west to east within a row.
+
+ @param region Region to cover.
+ @param level Detail level of the tiles.
+ @param keys Buffer receiving quad key bits. May be `NULL` when `capacity` is `0`.
+ @param capacity Capacity of the `keys` buffer.
+ @return Total number of covering tiles. Only `MIN(result, capacity)` keys are written.
+ */
+FOUNDATION_EXPORT NSUInteger TKQuadKeyBitsCoveringRegion(MKCoordinateRegion region, UInt8 level,
+	uint64_t *_Nullable keys, NSUInteger capacity);
+
+/// Quad key string representation of the given bits on the given detail level.
+FOUNDATION_EXPORT NSString *TKQuadKeyStringFromBits(uint64_t bits, UInt8 level);
+
+
+///-----------------------------------------------------------------------------
+#pragma mark - Packed quad keys
+///-----------------------------------------------------------------------------
+
+
+/**
+ Compact quad key representation carrying both the digits and the detail level.
+
+ Digits are stored left-aligned in the upper bits, 2 bits per digit, the detail
+ level occupies the lowest 6 bits. Ordering of packed keys matches the ordering
+ of their string representations and prefix checks are plain bit masks.
+ */
+typedef uint64_t TKQuadKey;
+
+/// Invalid packed quad key value.
+#define TKQuadKeyInvalid   UINT64_MAX
+
+#define TK_QUADKEY_LEVEL_MASK   0x3FULL
+
+static inline uint64_t TKQuadKeyDigitsMask(UInt8 level)
+{
+	return (level) ? ~0ULL << (64 - 2 * level) : 0;
+}
+
+/// Packs the quad key bits of the given detail level.
+static inline TKQuadKey TKQuadKeyMake(uint64_t bits, UInt8 level)
+{
+	if (level > TK_QUADKEY_MAX_LEVEL) return TKQuadKeyInvalid;
+	if (!level) return 0;
+	return (bits << (64 - 2 * level)) | level;
+}
+
+/// Detail level of the packed quad key.
+static inline UInt8 TKQuadKeyLevel(TKQuadKey key)
+{
+	return (UInt8)(key & TK_QUADKEY_LEVEL_MASK);
+}
+
+/// Right-aligned quad key bits of the packed quad key.
+static inline uint64_t TKQuadKeyBits(TKQuadKey key)
+{
+	UInt8 level = TKQuadKeyLevel(key);
+	return (level) ? key >> (64 - 2 * level) : 0;
+}
+
+/// Ancestor of the packed quad key on the given (lower or equal) detail level.
+static inline TKQuadKey TKQuadKeyAncestor(TKQuadKey key, UInt8 level)
+{
+	if (key == TKQuadKeyInvalid || level > TKQuadKeyLevel(key)) return TKQuadKeyInvalid;
+	return (key & TKQuadKeyDigitsMask(level)) | level;
+}
+
+/// States whether `prefix` is the key itself or any of its ancestors.
+static inline BOOL TKQuadKeyHasPrefix(TKQuadKey key, TKQuadKey prefix)
+{
+	if (key == TKQuadKeyInvalid || prefix == TKQuadKeyInvalid) return NO;
+	UInt8 level = TKQuadKeyLevel(prefix);
+	if (level > TKQuadKeyLevel(key)) return NO;
+	return ((key ^ prefix) & TKQuadKeyDigitsMask(level)) == 0;
+}
+
+/// Packed quad key parsed from its string representation.
+/// Returns `TKQuadKeyInvalid` for malformed strings.
+FOUNDATION_EXPORT TKQuadKey TKQuadKeyFromString(NSString *_Nullable string);
+
+/// String representation of the packed quad key.
+FOUNDATION_EXPORT NSString *_Nullable TKQuadKeyToString(TKQuadKey key);
+
+NS_ASSUME_NONNULL_END
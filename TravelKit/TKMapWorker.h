@@ -16,6 +16,49 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+///---------------------------------------------------------------------------------------
+/// @name Polyline codec
+///---------------------------------------------------------------------------------------
+
+/**
+ Number of coordinates encoded in the given polyline byte buffer.
+
+ @param bytes UTF-8 polyline bytes. Escaped backslashes (`\\`) are accepted.
+ @param length Length of the buffer in bytes.
+ @return Number of coordinates `TKPolylineDecode()` would produce for well-formed input.
+ */
+FOUNDATION_EXPORT NSUInteger TKPolylineDecodedCount(const char *bytes, NSUInteger length);
+
+/**
+ Decodes the polyline byte buffer into a caller-provided coordinates buffer.
+
+ @param bytes UTF-8 polyline bytes. Escaped backslashes (`\\`) are accepted.
+ @param length Length of the buffer in bytes.
+ @param coordinates Buffer receiving the decoded coordinates.
+ @param capacity Capacity of the `coordinates` buffer.
+ @return Number of decoded coordinates or `NSNotFound` for malformed input or insufficient capacity.
+ */
+FOUNDATION_EXPORT NSUInteger TKPolylineDecode(const char *bytes, NSUInteger length,
+	CLLocationCoordinate2D *coordinates, NSUInteger capacity);
+
+/// Buffer length sufficient for encoding `count` coordinates.
+FOUNDATION_EXPORT NSUInteger TKPolylineEncodedLengthLimit(NSUInteger count);
+
+/**
+ Encodes the coordinates into a caller-provided byte buffer.
+
+ The buffer is not NUL-terminated.
+
+ @param coordinates Coordinates to encode.
+ @param count Number of coordinates.
+ @param bytes Buffer receiving the polyline bytes.
+ @param capacity Capacity of the `bytes` buffer. `TKPolylineEncodedLengthLimit()` is always sufficient.
+ @return Number of written bytes or `NSNotFound` for insufficient capacity.
+ */
+FOUNDATION_EXPORT NSUInteger TKPolylineEncode(const CLLocationCoordinate2D *coordinates, NSUInteger count,
+	char *bytes, NSUInteger capacity);
+
+
 @interface TKMapWorker : NSObject
 
 ///---------------------------------------------------------------------------------------
@@ -23,7 +66,10 @@ NS_ASSUME_NONNULL_BEGIN
 ///---------------------------------------------------------------------------------------
 
 /**
- Naive method for fetching standardised quad keys for the given region.
+ Method for fetching standardised quad keys for the given region.
+
+ Returns the exact set of map tiles covering the region on the detail level
+ given by `+detailLevelForRegion:`.
 
  @param region Region to calculate quad keys for.
  @return Array of quad key strings.
@@ -32,6 +78,17 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (NSString *)quadKeyForCoordinate:(CLLocationCoordinate2D)coorinate detailLevel:(UInt8)level;
 
+/**
+ Batch method converting a buffer of coordinates into quad keys in a single call.
+
+ @param coordinates Buffer of coordinates to convert.
+ @param count Number of coordinates in the buffer.
+ @param level Desired detail level of the quad keys.
+ @return Array of quad key strings matching the order of the given coordinates.
+ */
++ (NSArray<NSString *> *)quadKeysForCoordinates:(const CLLocationCoordinate2D *)coordinates
+	count:(NSUInteger)count detailLevel:(UInt8)level;
+
 + (UInt8)detailLevelForRegion:(MKCoordinateRegion)region;
 
 ///---------------------------------------------------------------------------------------
@@ -58,6 +115,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (NSArray<CLLocation *> *)pointsFromPolyline:(NSString *)polyline;
 
+/**
+ A function used to convert a polyline into `CLLocation` points appropriate for the given zoom level.
+
+ Vertices not distinguishable on the given zoom level are left out. Simplification
+ of each polyline is calculated once and cached.
+
+ @param polyline Given polyline string.
+ @param zoomLevel Zoom level the points are meant to be displayed on.
+ @return Calculated array of `CLLocation` points.
+ */
++ (NSArray<CLLocation *> *)pointsFromPolyline:(NSString *)polyline zoomLevel:(double)zoomLevel;
+
 /**
  A function used to convert `CLLocation` points into a polyline.
 
@@ -100,6 +169,124 @@ NS_ASSUME_NONNULL_BEGIN
                            toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
                          toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove;
 
+/**
+ Interpolating method for sorting Map annotations, reporting annotations changing their size.
+
+ Annotations are matched by their place ID in linear time. Displayed annotations whose
+ requested `pixelSize` differs get the new size assigned and are reported in `toRestyle`
+ instead of being removed and added again.
+
+ @param newAnnotations Array of annotations you'd like to display.
+ @param oldAnnotations Array of annotations currently displayed.
+ @param toAdd Out array of annotations to add to the map.
+ @param toKeep Out array of annotations to keep on the map.
+ @param toRestyle Out array of displayed annotations to keep on the map with an updated style.
+                  When `nil`, such annotations are reported in `toKeep`.
+ @param toRemove Out array of annotations to remove from the map.
+ */
++ (void)interpolateNewAnnotations:(NSArray<TKMapPlaceAnnotation *> *)newAnnotations
+                   oldAnnotations:(NSArray<TKMapPlaceAnnotation *> *)oldAnnotations
+                            toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
+                           toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
+                        toRestyle:(nullable NSMutableArray<TKMapPlaceAnnotation *> *)toRestyle
+                         toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove;
+
+@end
+
+
+/**
+ Polyline with precomputed level-of-detail ranking of its vertices.
+
+ Each vertex gets a minimal zoom level it becomes distinguishable on, based on its
+ Douglas-Peucker deviation in Mercator space. Vertex subsets of the particular zoom
+ levels are nested and their index lists are cached once requested.
+ */
+@interface TKSimplifiedPolyline : NSObject
+
+/// Number of vertices of the full polyline.
+@property (nonatomic, readonly) NSUInteger count;
+
+/// :nodoc:
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/**
+ Initialiser taking an encoded polyline.
+
+ @param polyline Encoded polyline string.
+ @return Initialised object.
+ */
+- (instancetype)initWithPolyline:(NSString *)polyline;
+
+/**
+ Initialiser taking a buffer of coordinates.
+
+ @param coordinates Buffer of coordinates.
+ @param count Number of coordinates in the buffer.
+ @return Initialised object.
+ */
+- (instancetype)initWithCoordinates:(const CLLocationCoordinate2D *)coordinates count:(NSUInteger)count;
+
+/**
+ Fills the buffer with vertices displayed on the given zoom level.
+
+ @param coordinates Buffer receiving the coordinates. May be `NULL` when `capacity` is `0`.
+ @param capacity Capacity of the `coordinates` buffer.
+ @param zoomLevel Zoom level the vertices are meant to be displayed on.
+ @return Total number of vertices on the given zoom level. Only `MIN(result, capacity)` are written.
+ */
+- (NSUInteger)getCoordinates:(nullable CLLocationCoordinate2D *)coordinates
+	capacity:(NSUInteger)capacity zoomLevel:(double)zoomLevel;
+
+/**
+ Vertices displayed on the given zoom level.
+
+ @param zoomLevel Zoom level the vertices are meant to be displayed on.
+ @return Array of `CLLocation` points.
+ */
+- (NSArray<CLLocation *> *)pointsForZoomLevel:(double)zoomLevel;
+
+@end
+
+
+/**
+ Stateful spreading object keeping the annotation placement between viewport changes.
+
+ Placement is evaluated per square world tile. Panning only evaluates tiles which have
+ newly entered the viewport, a zoom change re-evaluates the visible tiles on the new
+ minimal distance. Annotation instances of places keeping their spread class are stable
+ across updates.
+
+ @note The object is not thread-safe, use it from a single queue.
+ */
+@interface TKMapAnnotationSpreader : NSObject
+
+/// Annotations currently considered displayed.
+@property (nonatomic, copy, readonly) NSArray<TKMapPlaceAnnotation *> *displayedAnnotations;
+
+/**
+ Adds places to spread. Places with an already known ID are ignored.
+
+ @param places Places to add.
+ */
+- (void)addPlaces:(NSArray<TKPlace *> *)places;
+
+/// Removes all places. Displayed annotations are reported in `toRemove` on the next update.
+- (void)removeAllPlaces;
+
+/**
+ Updates the placement for the given viewport and reports the changes.
+
+ @param region Region displayed by the Map view.
+ @param size Standard size of the Map view. May be taken from either `-frame` or `-bounds`.
+ @param toAdd Out array of annotations to add to the map.
+ @param toKeep Out array of annotations to keep on the map.
+ @param toRemove Out array of annotations to remove from the map.
+ */
+- (void)updateForRegion:(MKCoordinateRegion)region mapViewSize:(CGSize)size
+                  toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
+                 toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
+               toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -9,6 +9,9 @@
 #import <TravelKit/Foundation+TravelKit.h>
 #import <TravelKit/TKMapWorker.h>
 
+#import "TKMapWorker+Private.h"
+#import "TKPlacesStore+Private.h"
+
 #define MINMAX(a, x, b) MIN(MAX(a, x), b)
 
 
@@ -17,337 +20,1426 @@ typedef struct {
 	double y;
 } TKMapPoint;
 
-typedef struct {
-	int64_t x;
-	int64_t y;
-} TKTilePoint;
-
-
-@implementation TKMapWorker
-
 
 #pragma mark -
-#pragma mark Quadkeys
+#pragma mark Quad key engine
 
 
-+ (double)tileMapSizeForDetailLevel:(UInt8)level
+static inline double TKTileMapSizeForDetailLevel(UInt8 level)
 {
-	if (level == 23)
+	if (level >= TK_QUADKEY_MAX_LEVEL)
 		return INT_MAX;
 
 	return 256 << level;
 }
 
-+ (TKMapPoint)pixelPointForCoordinate:(CLLocationCoordinate2D)coordinate detailLevel:(UInt8)level
+static inline TKMapPoint TKMercatorPointForCoordinate(CLLocationCoordinate2D coordinate)
 {
-	CLLocationDegrees lat = coordinate.latitude;
-	CLLocationDegrees lng = coordinate.longitude;
-
-	CLLocationDegrees fLat = MINMAX(-85.05112878, lat, 85.05112878);
-	CLLocationDegrees fLng = MINMAX(-180, lng, 180);
+	CLLocationDegrees fLat = MINMAX(-85.05112878, coordinate.latitude, 85.05112878);
+	CLLocationDegrees fLng = MINMAX(-180, coordinate.longitude, 180);
 
 	double x = (fLng + 180) / 360.0;
 	double sinLatitude = sin(fLat * M_PI / 180);
 	double y = 0.5 - log((1 + sinLatitude) / (1 - sinLatitude)) / (4 * M_PI);
 
-	double mapSize = [self tileMapSizeForDetailLevel:level];
-	double pixelX = MINMAX(0, x * mapSize + 0.5, mapSize - 1);
-	double pixelY = MINMAX(0, y * mapSize + 0.5, mapSize - 1);
+	return (TKMapPoint){ x, y };
+}
+
+static inline TKMapPoint TKPixelPointForCoordinate(CLLocationCoordinate2D coordinate, UInt8 level)
+{
+	TKMapPoint mercator = TKMercatorPointForCoordinate(coordinate);
+
+	double mapSize = TKTileMapSizeForDetailLevel(level);
+	double pixelX = MINMAX(0, mercator.x * mapSize + 0.5, mapSize - 1);
+	double pixelY = MINMAX(0, mercator.y * mapSize + 0.5, mapSize - 1);
 
 	return (TKMapPoint){ pixelX, pixelY };
 }
 
-+ (TKTilePoint)tilePointForPixelPoint:(TKMapPoint)pixelPoint
+static inline uint64_t TKSpreadTileBits(int64_t value)
 {
+	// Spread lower 32 bits so that there's a zero bit between each of them
+	uint64_t v = (uint32_t)value;
+	v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+	v = (v | (v <<  8)) & 0x00FF00FF00FF00FFULL;
+	v = (v | (v <<  4)) & 0x0F0F0F0F0F0F0F0FULL;
+	v = (v | (v <<  2)) & 0x3333333333333333ULL;
+	v = (v | (v <<  1)) & 0x5555555555555555ULL;
+	return v;
+}
+
+TKTilePoint TKTilePointForCoordinate(CLLocationCoordinate2D coordinate, UInt8 level)
+{
+	TKMapPoint pixelPoint = TKPixelPointForCoordinate(coordinate, level);
 	return (TKTilePoint){ ((int64_t)pixelPoint.x) / 256, ((int64_t)pixelPoint.y) / 256 };
 }
 
-+ (NSString *)quadKeyForTilePoint:(TKTilePoint)tilePoint detailLevel:(UInt8)level
+uint64_t TKQuadKeyBitsForTilePoint(TKTilePoint tilePoint)
+{
+	// Quad key digit is (x bit + 2 * y bit), so X bits go to even positions
+	return TKSpreadTileBits(tilePoint.x) | (TKSpreadTileBits(tilePoint.y) << 1);
+}
+
+uint64_t TKQuadKeyBitsForCoordinate(CLLocationCoordinate2D coordinate, UInt8 level)
+{
+	return TKQuadKeyBitsForTilePoint(TKTilePointForCoordinate(coordinate, level));
+}
+
+void TKQuadKeyBitsForCoordinates(const CLLocationCoordinate2D *coordinates,
+	NSUInteger count, UInt8 level, uint64_t *keys)
+{
+	for (NSUInteger i = 0; i < count; i++)
+		keys[i] = TKQuadKeyBitsForCoordinate(coordinates[i], level);
+}
+
+NSUInteger TKQuadKeyBitsCoveringRegion(MKCoordinateRegion region, UInt8 level,
+	uint64_t *keys, NSUInteger capacity)
 {
-	NSMutableString *quadKey = [NSMutableString string];
+	CLLocationDegrees latSpan = region.span.latitudeDelta;
+	CLLocationDegrees lngSpan = region.span.longitudeDelta;
+
+	CLLocationCoordinate2D southWest = CLLocationCoordinate2DMake(
+		region.center.latitude - latSpan/2, region.center.longitude - lngSpan/2);
+	CLLocationCoordinate2D northEast = CLLocationCoordinate2DMake(
+		region.center.latitude + latSpan/2, region.center.longitude + lngSpan/2);
+
+	// Corner tiles span the covering rectangle, tile Y grows southwards
+	TKTilePoint swTile = TKTilePointForCoordinate(southWest, level);
+	TKTilePoint neTile = TKTilePointForCoordinate(northEast, level);
 
-	for (int i = level; i > 0; i--)
+	int64_t minX = MIN(swTile.x, neTile.x), maxX = MAX(swTile.x, neTile.x);
+	int64_t minY = MIN(swTile.y, neTile.y), maxY = MAX(swTile.y, neTile.y);
+
+	NSUInteger total = (NSUInteger)((maxX - minX + 1) * (maxY - minY + 1));
+
+	if (!keys || !capacity) return total;
+
+	// Rows are emitted from south to north, tiles within a row from west to east
+	NSUInteger written = 0;
+	for (int64_t y = maxY; y >= minY && written < capacity; y--)
 	{
-		int digit = 0;
-		int mask = 1 << (i - 1);
-		if ((tilePoint.x & mask) != 0)
-			digit++;
-		if ((tilePoint.y & mask) != 0)
-			digit += 2;
-		[quadKey appendString:[@(digit) stringValue]];
+		uint64_t yBits = TKSpreadTileBits(y) << 1;
+		for (int64_t x = minX; x <= maxX && written < capacity; x++)
+			keys[written++] = TKSpreadTileBits(x) | yBits;
 	}
 
-	return quadKey;
+	return total;
 }
 
-+ (NSString *)quadKeyForCoordinate:(CLLocationCoordinate2D)coorinate detailLevel:(UInt8)level
+NSString *TKQuadKeyStringFromBits(uint64_t bits, UInt8 level)
 {
-//	if (levelOfDetail < 1 || levelOfDetail > 23)
-//		throw "levelOfDetail needs to be between 1 and 23";
+	level = MIN(level, TK_QUADKEY_MAX_LEVEL);
 
-	TKMapPoint pixelPoint = [self pixelPointForCoordinate:coorinate detailLevel:level];
-	TKTilePoint tilePoint = [self tilePointForPixelPoint:pixelPoint];
+	char digits[TK_QUADKEY_MAX_LEVEL];
 
-	return [self quadKeyForTilePoint:tilePoint detailLevel:level];
+	for (UInt8 i = 0; i < level; i++)
+		digits[i] = '0' + ((bits >> (2 * (level - i - 1))) & 0x3);
+
+	return [[NSString alloc] initWithBytes:digits length:level encoding:NSASCIIStringEncoding];
 }
 
-+ (UInt8)detailLevelForRegion:(MKCoordinateRegion)region
+TKQuadKey TKQuadKeyFromString(NSString *string)
 {
-	double zoomLevel = [self approximateZoomLevelForLatitudeSpan:region.span.latitudeDelta];
-	return (UInt8)round(MINMAX(1, zoomLevel, 18));
+	NSUInteger length = string.length;
+
+	if (!string || length > TK_QUADKEY_MAX_LEVEL)
+		return TKQuadKeyInvalid;
+
+	char digits[TK_QUADKEY_MAX_LEVEL+1];
+
+	if (![string getCString:digits maxLength:sizeof(digits) encoding:NSASCIIStringEncoding])
+		return TKQuadKeyInvalid;
+
+	uint64_t bits = 0;
+
+	for (NSUInteger i = 0; i < length; i++)
+	{
+		int digit = digits[i] - '0';
+		if (digit < 0 || digit > 3) return TKQuadKeyInvalid;
+		bits = (bits << 2) | (uint64_t)digit;
+	}
+
+	return TKQuadKeyMake(bits, (UInt8)length);
 }
 
-+ (NSArray<NSString *> *)quadKeysForRegion:(MKCoordinateRegion)region
+NSString *TKQuadKeyToString(TKQuadKey key)
 {
-	UInt8 zoomLevel = [self detailLevelForRegion:region];
+	if (key == TKQuadKeyInvalid || TKQuadKeyLevel(key) > TK_QUADKEY_MAX_LEVEL)
+		return nil;
+
+	return TKQuadKeyStringFromBits(TKQuadKeyBits(key), TKQuadKeyLevel(key));
+}
 
-	NSMutableArray<CLLocation *> *checkPoints = [NSMutableArray array];
 
+#pragma mark -
+#pragma mark Spreading grid
+
+
+typedef NS_ENUM(UInt8, TKSpreadClass) {
+	TKSpreadClassFirst = 0,
+	TKSpreadClassSecond,
+	TKSpreadClassThird,
+	TKSpreadClassNone = UINT8_MAX,
+};
+
+// Minimal distance between annotations with basic size of 64 pixels
+static const double kTKSpreadMinimalDistance = 76;
+
+// Pixel sizes of annotations of the particular classes
+static const double kTKSpreadPixelSizes[3] = { 64, 42, 14 };
+
+// Fractions of the minimal distance required between classes
+static const double kTKSpreadDistanceFactors[3][3] = {
+	{ 1.00, 0.95, 0.70 },
+	{ 0.95, 0.85, 0.60 },
+	{ 0.70, 0.60, 0.50 },
+};
+
+/// Uniform hash grid of accepted annotation points. Cell size equals the largest
+/// required distance, so only the 3×3 neighbouring cells need to be checked.
+typedef struct {
+	double cellSize;
+	NSUInteger bucketMask;
+	NSInteger *buckets;
+	NSInteger *next;
+	TKMapPoint *points;
+	UInt8 *classes;
+	NSUInteger count;
+	NSUInteger capacity;
+} TKSpreadGrid;
+
+static inline double TKSpreadWorldSizeForRegion(MKCoordinateRegion region, CGSize size)
+{
 	CLLocationDegrees latSpan = region.span.latitudeDelta;
-	CLLocationDegrees lngSpan = region.span.longitudeDelta;
+	TKMapPoint north = TKMercatorPointForCoordinate(CLLocationCoordinate2DMake(
+		region.center.latitude + latSpan/2, region.center.longitude));
+	TKMapPoint south = TKMercatorPointForCoordinate(CLLocationCoordinate2DMake(
+		region.center.latitude - latSpan/2, region.center.longitude));
+
+	double spanY = MAX(south.y - north.y, DBL_EPSILON);
+
+	return MAX(size.height, 1) / spanY;
+}
+
+static inline NSUInteger TKSpreadGridBucket(const TKSpreadGrid *grid, int64_t cellX, int64_t cellY)
+{
+	uint64_t hash = ((uint64_t)cellX * 73856093ULL) ^ ((uint64_t)cellY * 19349663ULL);
+	return (NSUInteger)(hash ^ (hash >> 29)) & grid->bucketMask;
+}
 
-	for (uint i = 0; i <= 10; i++)
-		for (uint j = 0; j <= 10; j++)
+static inline NSUInteger TKSpreadGridBucketForPoint(const TKSpreadGrid *grid, TKMapPoint point)
+{
+	return TKSpreadGridBucket(grid,
+		(int64_t)floor(point.x / grid->cellSize), (int64_t)floor(point.y / grid->cellSize));
+}
+
+static BOOL TKSpreadGridRehash(TKSpreadGrid *grid, NSUInteger bucketsCount)
+{
+	NSInteger *buckets = malloc(bucketsCount * sizeof(NSInteger));
+	if (!buckets) return NO;
+
+	free(grid->buckets);
+	grid->buckets = buckets;
+	grid->bucketMask = bucketsCount - 1;
+
+	for (NSUInteger i = 0; i < bucketsCount; i++)
+		buckets[i] = NSNotFound;
+
+	for (NSUInteger i = 0; i < grid->count; i++) {
+		NSUInteger bucket = TKSpreadGridBucketForPoint(grid, grid->points[i]);
+		grid->next[i] = buckets[bucket];
+		buckets[bucket] = (NSInteger)i;
+	}
+
+	return YES;
+}
+
+static BOOL TKSpreadGridReserve(TKSpreadGrid *grid, NSUInteger capacity)
+{
+	if (capacity <= grid->capacity) return YES;
+
+	NSInteger *next = realloc(grid->next, capacity * sizeof(NSInteger));
+	if (next) grid->next = next;
+	TKMapPoint *points = realloc(grid->points, capacity * sizeof(TKMapPoint));
+	if (points) grid->points = points;
+	UInt8 *classes = realloc(grid->classes, capacity * sizeof(UInt8));
+	if (classes) grid->classes = classes;
+
+	if (!next || !points || !classes) return NO;
+
+	grid->capacity = capacity;
+
+	// Keep the load factor of the buckets at most 1/2
+	NSUInteger bucketsCount = 64;
+	while (bucketsCount < 2 * capacity) bucketsCount <<= 1;
+
+	return (bucketsCount > grid->bucketMask + 1) ?
+		TKSpreadGridRehash(grid, bucketsCount) : YES;
+}
+
+static BOOL TKSpreadGridInit(TKSpreadGrid *grid, double cellSize, NSUInteger capacity)
+{
+	memset(grid, 0, sizeof(TKSpreadGrid));
+	grid->cellSize = cellSize;
+
+	if (TKSpreadGridReserve(grid, MAX(capacity, 16)) && grid->buckets)
+		return YES;
+
+	free(grid->buckets); free(grid->next);
+	free(grid->points); free(grid->classes);
+	memset(grid, 0, sizeof(TKSpreadGrid));
+
+	return NO;
+}
+
+static void TKSpreadGridFree(TKSpreadGrid *grid)
+{
+	free(grid->buckets);
+	free(grid->next);
+	free(grid->points);
+	free(grid->classes);
+	memset(grid, 0, sizeof(TKSpreadGrid));
+}
+
+static void TKSpreadGridInsert(TKSpreadGrid *grid, TKMapPoint point, TKSpreadClass cls)
+{
+	if (grid->count == grid->capacity && !TKSpreadGridReserve(grid, 2 * grid->capacity))
+		return;
+
+	NSUInteger idx = grid->count++;
+	NSUInteger bucket = TKSpreadGridBucketForPoint(grid, point);
+
+	grid->points[idx] = point;
+	grid->classes[idx] = cls;
+	grid->next[idx] = grid->buckets[bucket];
+	grid->buckets[bucket] = (NSInteger)idx;
+}
+
+static BOOL TKSpreadGridHasConflict(const TKSpreadGrid *grid, TKMapPoint point, TKSpreadClass cls)
+{
+	int64_t cellX = (int64_t)floor(point.x / grid->cellSize);
+	int64_t cellY = (int64_t)floor(point.y / grid->cellSize);
+
+	const double *factors = kTKSpreadDistanceFactors[cls];
+	double minDistance = grid->cellSize;
+
+	for (int64_t dy = -1; dy <= 1; dy++)
+		for (int64_t dx = -1; dx <= 1; dx++)
 		{
-			CLLocationDegrees locLat = (region.center.latitude-latSpan/2) + i*(latSpan/10);
-			CLLocationDegrees locLng = (region.center.longitude-lngSpan/2) + j*(lngSpan/10);
-			[checkPoints addObject:[[CLLocation alloc] initWithLatitude:locLat longitude:locLng]];
+			NSInteger idx = grid->buckets[TKSpreadGridBucket(grid, cellX + dx, cellY + dy)];
+
+			// Bucket chains may also hold points of colliding cells,
+			// the exact distance check handles those as well
+			for (; idx != NSNotFound; idx = grid->next[idx])
+			{
+				double limit = factors[grid->classes[idx]] * minDistance;
+				double distX = grid->points[idx].x - point.x;
+				double distY = grid->points[idx].y - point.y;
+				if (distX*distX + distY*distY < limit*limit)
+					return YES;
+			}
 		}
 
-	NSMutableOrderedSet<NSString *> *quadKeys = [NSMutableOrderedSet orderedSetWithCapacity:10];
+	return NO;
+}
+
+/// Best class a place may be assigned -- well rated places with a photo
+/// are preferred to other places with a photo, the rest comes last.
+static inline TKSpreadClass TKSpreadPreferredClass(float rating, BOOL hasThumbnail)
+{
+	if (!hasThumbnail) return TKSpreadClassThird;
+	return (rating >= 6.0) ? TKSpreadClassFirst : TKSpreadClassSecond;
+}
+
+static inline TKSpreadClass TKSpreadPreferredClassForPlace(TKPlace *place)
+{
+	return TKSpreadPreferredClass(place.rating.floatValue, place.thumbnailURL != nil);
+}
+
+static inline TKSpreadClass TKSpreadPreferredClassForStored(TKPlacesStore *store, NSUInteger index)
+{
+	// NAN ratings fail the comparison the same way missing ones do
+	return TKSpreadPreferredClass([store ratingAtIndex:index],
+		([store flagsAtIndex:index] & TKPlacesStoreFlagThumbnail) != 0);
+}
+
+/// Runs the 3 spreading passes over the given candidates of unassigned class.
+/// `indexes` may be `NULL` to evaluate the first `count` places.
+static void TKSpreadCandidates(TKSpreadGrid *grid, const UInt8 *preferred,
+	const TKMapPoint *points, UInt8 *classes, const NSUInteger *_Nullable indexes, NSUInteger count)
+{
+	// First class -- well rated places with a photo
+	for (NSUInteger n = 0; n < count; n++)
+	{
+		NSUInteger i = (indexes) ? indexes[n] : n;
+		if (preferred[i] != TKSpreadClassFirst) continue;
+		if (!TKSpreadGridHasConflict(grid, points[i], TKSpreadClassFirst))
+			TKSpreadGridInsert(grid, points[i], classes[i] = TKSpreadClassFirst);
+	}
 
-	for (CLLocation *location in checkPoints) {
-		NSString *quadKey = [self quadKeyForCoordinate:location.coordinate detailLevel:zoomLevel];
-		if (quadKey) [quadKeys addObject:quadKey];
+	// Second class -- other places with a photo
+	for (NSUInteger n = 0; n < count; n++)
+	{
+		NSUInteger i = (indexes) ? indexes[n] : n;
+		if (classes[i] != TKSpreadClassNone || preferred[i] > TKSpreadClassSecond) continue;
+		if (!TKSpreadGridHasConflict(grid, points[i], TKSpreadClassSecond))
+			TKSpreadGridInsert(grid, points[i], classes[i] = TKSpreadClassSecond);
 	}
 
-	return [quadKeys array];
+	// Third class -- the rest
+	for (NSUInteger n = 0; n < count; n++)
+	{
+		NSUInteger i = (indexes) ? indexes[n] : n;
+		if (classes[i] != TKSpreadClassNone) continue;
+		if (!TKSpreadGridHasConflict(grid, points[i], TKSpreadClassThird))
+			TKSpreadGridInsert(grid, points[i], classes[i] = TKSpreadClassThird);
+	}
 }
 
 
 #pragma mark -
-#pragma mark Regions
+#pragma mark Polyline codec
 
 
-+ (double)approximateZoomLevelForLatitudeSpan:(CLLocationDegrees)latitudeSpan
+#define TK_POLYLINE_OFFSET        63
+#define TK_POLYLINE_CHUNK_BITS    5
+#define TK_POLYLINE_CHUNK_MASK    0x1F
+#define TK_POLYLINE_CONTINUATION  0x20
+#define TK_POLYLINE_ESCAPE        '\\'
+
+// Maximal number of chunks of a single 64-bit value
+#define TK_POLYLINE_MAX_CHUNKS    13
+
+static const double kTKPolylinePrecision = 1e5;
+
+NSUInteger TKPolylineDecodedCount(const char *bytes, NSUInteger length)
 {
-	return 8.257237*pow(latitudeSpan, -0.1497541);
-}
+	const uint8_t *b = (const uint8_t *)bytes;
+	NSUInteger terminators = 0, escapes = 0;
 
+	// Every value ends with a chunk lacking the continuation bit
+	for (NSUInteger i = 0; i < length; i++)
+		terminators += (b[i] < TK_POLYLINE_OFFSET + TK_POLYLINE_CONTINUATION);
 
-#pragma mark -
-#pragma mark Polylines
+	// Escaped backslash pairs stand for a single terminating chunk
+	for (NSUInteger i = 0; i + 1 < length; i++)
+		if (b[i] == TK_POLYLINE_ESCAPE && b[i+1] == TK_POLYLINE_ESCAPE)
+			escapes++, i++;
 
+	return (terminators - escapes) / 2;
+}
 
-+ (NSArray<CLLocation *> *)pointsFromPolyline:(NSString *)polyline
+static inline BOOL TKPolylineDecodeValue(const uint8_t *b, NSUInteger length, NSUInteger *index, int64_t *value)
 {
-	@try
+	uint64_t result = 0;
+	NSUInteger i = *index;
+
+	for (unsigned shift = 0; shift < TK_POLYLINE_MAX_CHUNKS * TK_POLYLINE_CHUNK_BITS; shift += TK_POLYLINE_CHUNK_BITS)
 	{
-		NSMutableString *encoded = [polyline mutableCopy];
-		[encoded replaceOccurrencesOfString:@"\\\\" withString:@"\\"
-									options:NSLiteralSearch
-									  range:NSMakeRange(0, [encoded length])];
-
-		NSUInteger len = [encoded length], index = 0;
-		NSInteger lat = 0, lng = 0;
-		NSMutableArray *array = [[NSMutableArray alloc] init];
-
-		while (index < len) {
-			NSInteger b;
-			NSInteger shift = 0;
-			NSInteger result = 0;
-			do {
-				b = [encoded characterAtIndex:index++] - 63;
-				result |= (b & 0x1f) << shift;
-				shift += 5;
-			} while (b >= 0x20);
-			NSInteger dlat = ((result & 1) ? ~(result >> 1) : (result >> 1));
-			lat += dlat;
-			shift = 0;
-			result = 0;
-			do {
-				b = [encoded characterAtIndex:index++] - 63;
-				result |= (b & 0x1f) << shift;
-				shift += 5;
-			} while (b >= 0x20);
-			NSInteger dlng = ((result & 1) ? ~(result >> 1) : (result >> 1));
-			lng += dlng;
-			NSNumber *latitude = @(lat * 1e-5);
-			NSNumber *longitude = @(lng * 1e-5);
-
-			CLLocation *location = [[CLLocation alloc] initWithLatitude:[latitude floatValue] longitude:[longitude floatValue]];
-			[array addObject:location];
+		if (i >= length) return NO;
+
+		uint8_t c = b[i++];
+		if (c == TK_POLYLINE_ESCAPE && i < length && b[i] == TK_POLYLINE_ESCAPE) i++;
+
+		uint32_t chunk = (uint32_t)c - TK_POLYLINE_OFFSET;
+		if (chunk >= 2 * TK_POLYLINE_CONTINUATION) return NO;
+
+		result |= (uint64_t)(chunk & TK_POLYLINE_CHUNK_MASK) << shift;
+
+		if (!(chunk & TK_POLYLINE_CONTINUATION)) {
+			*index = i;
+			*value = (int64_t)(result >> 1) ^ -(int64_t)(result & 1);
+			return YES;
 		}
+	}
+
+	return NO;
+}
+
+NSUInteger TKPolylineDecode(const char *bytes, NSUInteger length,
+	CLLocationCoordinate2D *coordinates, NSUInteger capacity)
+{
+	const uint8_t *b = (const uint8_t *)bytes;
+	NSUInteger index = 0, count = 0;
+	int64_t lat = 0, lng = 0, dLat, dLng;
+
+	while (index < length)
+	{
+		if (count >= capacity ||
+		    !TKPolylineDecodeValue(b, length, &index, &dLat) ||
+		    !TKPolylineDecodeValue(b, length, &index, &dLng))
+			return NSNotFound;
+
+		lat += dLat; lng += dLng;
+		coordinates[count++] = CLLocationCoordinate2DMake(
+			lat / kTKPolylinePrecision, lng / kTKPolylinePrecision);
+	}
+
+	return count;
+}
+
+NSUInteger TKPolylineEncodedLengthLimit(NSUInteger count)
+{
+	return count * 2 * TK_POLYLINE_MAX_CHUNKS;
+}
+
+static inline NSUInteger TKPolylineEncodeValue(int64_t value, char *bytes, NSUInteger index)
+{
+	uint64_t v = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
 
-		return array;
+	while (v >= TK_POLYLINE_CONTINUATION) {
+		bytes[index++] = (char)((TK_POLYLINE_CONTINUATION | (v & TK_POLYLINE_CHUNK_MASK)) + TK_POLYLINE_OFFSET);
+		v >>= TK_POLYLINE_CHUNK_BITS;
 	}
-	@catch (NSException *exception)
+
+	bytes[index++] = (char)(v + TK_POLYLINE_OFFSET);
+
+	return index;
+}
+
+static inline int64_t TKPolylineFixedValue(CLLocationDegrees degrees)
+{
+	return (isfinite(degrees)) ? llround(degrees * kTKPolylinePrecision) : 0;
+}
+
+NSUInteger TKPolylineEncode(const CLLocationCoordinate2D *coordinates, NSUInteger count,
+	char *bytes, NSUInteger capacity)
+{
+	NSUInteger index = 0;
+	int64_t prevLat = 0, prevLng = 0;
+	char chunks[2 * TK_POLYLINE_MAX_CHUNKS];
+
+	for (NSUInteger i = 0; i < count; i++)
 	{
-		return @[ ];
+		// Deltas of rounded values so the rounding error does not accumulate
+		int64_t lat = TKPolylineFixedValue(coordinates[i].latitude);
+		int64_t lng = TKPolylineFixedValue(coordinates[i].longitude);
+
+		NSUInteger used = TKPolylineEncodeValue(lat - prevLat, chunks, 0);
+		used = TKPolylineEncodeValue(lng - prevLng, chunks, used);
+
+		if (used > capacity - index) return NSNotFound;
+
+		memcpy(bytes + index, chunks, used);
+		index += used;
+
+		prevLat = lat; prevLng = lng;
 	}
+
+	return index;
 }
 
-+ (NSString *)polylineFromPoints:(NSArray<CLLocation *> *)points
+
+#pragma mark -
+#pragma mark Polyline simplification
+
+
+// Deviation in screen pixels considered indistinguishable
+static const double kTKPolylineTolerance = 1;
+
+// Base tile size of the zoom level pixel space
+static const double kTKPolylineTileSize = 256;
+
+static inline double TKPolylineSegmentDistance(TKMapPoint p, TKMapPoint a, TKMapPoint b)
 {
-	NSMutableString *encodedString = [NSMutableString string];
-	int val = 0;
-	int value = 0;
-	CLLocationCoordinate2D prevCoordinate = CLLocationCoordinate2DMake(0, 0);
+	double dx = b.x - a.x, dy = b.y - a.y;
+	double lengthSquared = dx*dx + dy*dy;
+	double t = (lengthSquared > 0) ?
+		MINMAX(0, ((p.x - a.x) * dx + (p.y - a.y) * dy) / lengthSquared, 1) : 0;
+	double ex = a.x + t * dx - p.x, ey = a.y + t * dy - p.y;
+	return sqrt(ex*ex + ey*ey);
+}
 
-	for (CLLocation *location in points)
+/// Assigns each vertex a minimal zoom level it is displayed on. Deviations are clamped
+/// by the deviation of the parent split so the vertex subsets of the levels are nested.
+static void TKPolylineRankVertices(const CLLocationCoordinate2D *coordinates, NSUInteger count, UInt8 *minZooms)
+{
+	if (!count) return;
+
+	TKMapPoint *points = malloc(count * sizeof(TKMapPoint));
+	NSUInteger *stack = malloc(2 * count * sizeof(NSUInteger));
+	double *limits = malloc(count * sizeof(double));
+
+	if (!points || !stack || !limits) {
+		// Fall back to the full resolution on every level
+		memset(minZooms, 0, count);
+		free(points); free(stack); free(limits);
+		return;
+	}
+
+	for (NSUInteger i = 0; i < count; i++) {
+		points[i] = TKMercatorPointForCoordinate(coordinates[i]);
+		minZooms[i] = TK_QUADKEY_MAX_LEVEL;
+	}
+
+	minZooms[0] = minZooms[count-1] = 0;
+
+	NSUInteger depth = 0;
+
+	if (count > 2) {
+		stack[depth] = 0; stack[depth+1] = count-1;
+		limits[depth/2] = INFINITY;
+		depth += 2;
+	}
+
+	while (depth)
 	{
-		CLLocationCoordinate2D coordinate = location.coordinate;
-
-		// Encode latitude
-		val = (int)round((coordinate.latitude - prevCoordinate.latitude) * 1e5);
-		val = (val < 0) ? ~(val<<1) : (val <<1);
-		while (val >= 0x20) {
-			value = (0x20|(val & 31)) + 63;
-			[encodedString appendFormat:@"%c", value];
-			val >>= 5;
+		depth -= 2;
+		NSUInteger first = stack[depth], last = stack[depth+1];
+		double limit = limits[depth/2];
+
+		double maxDistance = 0;
+		NSUInteger split = first;
+
+		for (NSUInteger i = first + 1; i < last; i++) {
+			double distance = TKPolylineSegmentDistance(points[i], points[first], points[last]);
+			if (distance > maxDistance) { maxDistance = distance; split = i; }
 		}
-		[encodedString appendFormat:@"%c", val + 63];
-
-		// Encode longitude
-		val = (int)round((coordinate.longitude - prevCoordinate.longitude) * 1e5);
-		val = (val < 0) ? ~(val<<1) : (val <<1);
-		while (val >= 0x20) {
-			value = (0x20|(val & 31)) + 63;
-			[encodedString appendFormat:@"%c", value];
-			val >>= 5;
+
+		if (split == first) continue;
+
+		double deviation = MIN(maxDistance, limit);
+
+		// Level on which the deviation reaches the pixel tolerance
+		double level = ceil(log2(kTKPolylineTolerance / (deviation * kTKPolylineTileSize)));
+		minZooms[split] = (UInt8)MINMAX(0, level, TK_QUADKEY_MAX_LEVEL);
+
+		if (split - first > 1) {
+			stack[depth] = first; stack[depth+1] = split;
+			limits[depth/2] = deviation;
+			depth += 2;
 		}
-		[encodedString appendFormat:@"%c", val + 63];
 
-		prevCoordinate = coordinate;
+		if (last - split > 1) {
+			stack[depth] = split; stack[depth+1] = last;
+			limits[depth/2] = deviation;
+			depth += 2;
+		}
 	}
-	
-	return encodedString;
+
+	free(points);
+	free(stack);
+	free(limits);
 }
 
 
+@implementation TKMapWorker
+
+
 #pragma mark -
-#pragma mark Spreading
+#pragma mark Quadkeys
 
 
-+ (NSArray<TKMapPlaceAnnotation *> *)spreadAnnotationsForPlaces:(NSArray<TKPlace *> *)places
-	mapRegion:(MKCoordinateRegion)region mapViewSize:(CGSize)size
++ (NSString *)quadKeyForCoordinate:(CLLocationCoordinate2D)coorinate detailLevel:(UInt8)level
+{
+	return TKQuadKeyStringFromBits(TKQuadKeyBitsForCoordinate(coorinate, level), level);
+}
+
++ (NSArray<NSString *> *)quadKeysForCoordinates:(const CLLocationCoordinate2D *)coordinates
+	count:(NSUInteger)count detailLevel:(UInt8)level
 {
-	NSMutableArray<TKPlace *> *workingPlaces = [places mutableCopy];
+	if (!coordinates || !count) return @[ ];
 
-	// Minimal distance between annotations with basic size of 64 pixels
-	CLLocationDistance minDistance = region.span.latitudeDelta / (size.height / 76) * 111000;
+	uint64_t *keys = malloc(count * sizeof(uint64_t));
+	if (!keys) return @[ ];
 
-	NSMutableArray<TKMapPlaceAnnotation *> *annotations = [NSMutableArray arrayWithCapacity:workingPlaces.count];
+	TKQuadKeyBitsForCoordinates(coordinates, count, level, keys);
 
-	NSMutableArray<TKPlace *> *firstClass   = [NSMutableArray arrayWithCapacity:workingPlaces.count / 4];
-	NSMutableArray<TKPlace *> *secondClass  = [NSMutableArray arrayWithCapacity:workingPlaces.count / 2];
-	NSMutableArray<TKPlace *> *thirdClass   = [NSMutableArray arrayWithCapacity:workingPlaces.count / 2];
+	NSMutableArray<NSString *> *quadKeys = [NSMutableArray arrayWithCapacity:count];
 
-	for (TKPlace *p in workingPlaces)
-	{
-		if (p.rating.floatValue < 6.0 || !p.thumbnailURL) continue;
+	for (NSUInteger i = 0; i < count; i++)
+		[quadKeys addObject:TKQuadKeyStringFromBits(keys[i], level)];
 
-		BOOL conflict = NO;
-		for (TKPlace *i in firstClass)
-			if ([i.location distanceFromLocation:p.location] < minDistance)
-			{ conflict = YES; break; }
-		if (!conflict) [firstClass addObject:p];
-	}
+	free(keys);
 
-	[workingPlaces removeObjectsInArray:firstClass];
+	return quadKeys;
+}
 
-	for (TKPlace *p in workingPlaces)
-	{
-		if (!p.thumbnailURL) continue;
++ (UInt8)detailLevelForRegion:(MKCoordinateRegion)region
+{
+	double zoomLevel = [self approximateZoomLevelForLatitudeSpan:region.span.latitudeDelta];
+	return (UInt8)round(MINMAX(1, zoomLevel, 18));
+}
+
++ (NSArray<NSString *> *)quadKeysForRegion:(MKCoordinateRegion)region
+{
+	UInt8 zoomLevel = [self detailLevelForRegion:region];
+
+	uint64_t stackKeys[64];
+	uint64_t *keys = stackKeys;
 
-		BOOL conflict = NO;
-		for (TKPlace *i in firstClass)
-			if ([i.location distanceFromLocation:p.location] < 0.95*minDistance)
-			{ conflict = YES; break; }
-		for (TKPlace *i in secondClass)
-			if ([i.location distanceFromLocation:p.location] < 0.85*minDistance)
-			{ conflict = YES; break; }
-		if (!conflict) [secondClass addObject:p];
+	NSUInteger count = TKQuadKeyBitsCoveringRegion(region, zoomLevel, keys, 64);
+
+	if (count > 64) {
+		keys = malloc(count * sizeof(uint64_t));
+		if (!keys) return @[ ];
+		TKQuadKeyBitsCoveringRegion(region, zoomLevel, keys, count);
 	}
 
-	[workingPlaces removeObjectsInArray:secondClass];
+	NSMutableArray<NSString *> *quadKeys = [NSMutableArray arrayWithCapacity:count];
 
-	for (TKPlace *p in workingPlaces)
-	{
-		BOOL conflict = NO;
-		for (TKPlace *i in firstClass)
-			if ([i.location distanceFromLocation:p.location] < 0.7*minDistance)
-			{ conflict = YES; break; }
-		for (TKPlace *i in secondClass)
-			if ([i.location distanceFromLocation:p.location] < 0.6*minDistance)
-			{ conflict = YES; break; }
-		for (TKPlace *i in thirdClass)
-			if ([i.location distanceFromLocation:p.location] < 0.5*minDistance)
-			{ conflict = YES; break; }
-		if (!conflict) [thirdClass addObject:p];
-	}
-
-	NSArray<TKMapPlaceAnnotation *> *classAnnotations = [firstClass
-	  mappedArrayUsingBlock:^id _Nullable(TKPlace * _Nonnull place) {
-		TKMapPlaceAnnotation *anno = [[TKMapPlaceAnnotation alloc] initWithPlace:place];
-		anno.pixelSize = 64;
-		return anno;
-	}];
+	for (NSUInteger i = 0; i < count; i++)
+		[quadKeys addObject:TKQuadKeyStringFromBits(keys[i], zoomLevel)];
 
-	[annotations addObjectsFromArray:classAnnotations];
+	if (keys != stackKeys)
+		free(keys);
 
-	classAnnotations = [secondClass
-	  mappedArrayUsingBlock:^id _Nullable(TKPlace * _Nonnull place) {
-		TKMapPlaceAnnotation *anno = [[TKMapPlaceAnnotation alloc] initWithPlace:place];
-		anno.pixelSize = 42;
-		return anno;
-	}];
+	return quadKeys;
+}
 
-	[annotations addObjectsFromArray:classAnnotations];
 
-	classAnnotations = [thirdClass
-	  mappedArrayUsingBlock:^id _Nullable(TKPlace * _Nonnull place) {
-		TKMapPlaceAnnotation *anno = [[TKMapPlaceAnnotation alloc] initWithPlace:place];
-		anno.pixelSize = 14;
-		return anno;
-	}];
+#pragma mark -
+#pragma mark Regions
 
-	[annotations addObjectsFromArray:classAnnotations];
 
-	return annotations;
++ (double)approximateZoomLevelForLatitudeSpan:(CLLocationDegrees)latitudeSpan
+{
+	return 8.257237*pow(latitudeSpan, -0.1497541);
 }
 
-+ (void)interpolateNewAnnotations:(NSArray<TKMapPlaceAnnotation *> *)newAnnotations
-                   oldAnnotations:(NSArray<TKMapPlaceAnnotation *> *)oldAnnotations
-                            toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
-                           toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
-                         toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove
+
+#pragma mark -
+#pragma mark Polylines
+
+
++ (NSArray<CLLocation *> *)pointsFromPolyline:(NSString *)polyline
 {
-	NSArray<NSString *> *displayedIDs = [newAnnotations
-	  mappedArrayUsingBlock:^id _Nullable(TKMapPlaceAnnotation *p) {
-		return p.place.ID;
-	}];
+	if (![polyline isKindOfClass:[NSString class]]) return @[ ];
 
-	for (TKMapPlaceAnnotation *p in oldAnnotations)
-	{
-		if (![p isKindOfClass:[TKMapPlaceAnnotation class]]) continue;
+	const char *bytes = CFStringGetCStringPtr((__bridge CFStringRef)polyline, kCFStringEncodingASCII)
+		?: polyline.UTF8String;
 
-		if ([displayedIDs containsObject:p.place.ID])
-			[toKeep addObject:p];
-		else [toRemove addObject:p];
-	}
+	if (!bytes) return @[ ];
 
-	for (TKMapPlaceAnnotation *p in newAnnotations)
-	{
-		if (![p isKindOfClass:[TKMapPlaceAnnotation class]]) continue;
+	NSUInteger length = strlen(bytes);
+	NSUInteger count = TKPolylineDecodedCount(bytes, length);
 
-		BOOL displayed = NO;
-		for (TKMapPlaceAnnotation *k in toKeep)
-			if ([k.place.ID isEqual:p.place.ID])
-				displayed = YES;
-		if (!displayed)
-			[toAdd addObject:p];
+	if (!count) return @[ ];
+
+	CLLocationCoordinate2D *coordinates = malloc(count * sizeof(CLLocationCoordinate2D));
+
+	if (!coordinates) return @[ ];
+
+	count = TKPolylineDecode(bytes, length, coordinates, count);
+
+	if (count == NSNotFound) {
+		free(coordinates);
+		return @[ ];
 	}
+
+	NSMutableArray<CLLocation *> *array = [NSMutableArray arrayWithCapacity:count];
+
+	for (NSUInteger i = 0; i < count; i++)
+		[array addObject:[[CLLocation alloc] initWithLatitude:coordinates[i].latitude
+		                                            longitude:coordinates[i].longitude]];
+
+	free(coordinates);
+
+	return array;
+}
+
++ (NSArray<CLLocation *> *)pointsFromPolyline:(NSString *)polyline zoomLevel:(double)zoomLevel
+{
+	if (![polyline isKindOfClass:[NSString class]]) return @[ ];
+
+	static NSCache<NSString *, TKSimplifiedPolyline *> *simplifiedCache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		simplifiedCache = [NSCache new];
+		simplifiedCache.countLimit = 128;
+	});
+
+	TKSimplifiedPolyline *simplified = [simplifiedCache objectForKey:polyline];
+
+	if (!simplified) {
+		simplified = [[TKSimplifiedPolyline alloc] initWithPolyline:polyline];
+		[simplifiedCache setObject:simplified forKey:polyline];
+	}
+
+	return [simplified pointsForZoomLevel:zoomLevel];
+}
+
++ (NSString *)polylineFromPoints:(NSArray<CLLocation *> *)points
+{
+	NSUInteger count = points.count;
+
+	if (!count) return @"";
+
+	NSUInteger capacity = TKPolylineEncodedLengthLimit(count);
+	CLLocationCoordinate2D *coordinates = malloc(count * sizeof(CLLocationCoordinate2D));
+	char *bytes = malloc(capacity);
+
+	if (!coordinates || !bytes) {
+		free(coordinates); free(bytes);
+		return @"";
+	}
+
+	NSUInteger i = 0;
+	for (CLLocation *location in points)
+		coordinates[i++] = location.coordinate;
+
+	NSUInteger length = TKPolylineEncode(coordinates, count, bytes, capacity);
+
+	free(coordinates);
+
+	if (length == NSNotFound) {
+		free(bytes);
+		return @"";
+	}
+
+	return [[NSString alloc] initWithBytesNoCopy:bytes length:length
+		encoding:NSASCIIStringEncoding freeWhenDone:YES] ?: @"";
+}
+
+
+#pragma mark -
+#pragma mark Spreading
+
+
++ (NSArray<TKMapPlaceAnnotation *> *)spreadAnnotationsForPlaces:(NSArray<TKPlace *> *)places
+	mapRegion:(MKCoordinateRegion)region mapViewSize:(CGSize)size
+{
+	NSUInteger count = places.count;
+
+	if (!count) return @[ ];
+
+	// Places are projected to the world pixel space of the current zoom,
+	// where the minimal distance is a constant pixel value
+	double worldSize = TKSpreadWorldSizeForRegion(region, size);
+
+	TKMapPoint *points = malloc(count * sizeof(TKMapPoint));
+	UInt8 *preferred = malloc(count * sizeof(UInt8));
+	UInt8 *classes = malloc(count * sizeof(UInt8));
+
+	TKSpreadGrid grid;
+
+	if (!points || !preferred || !classes || !TKSpreadGridInit(&grid, kTKSpreadMinimalDistance, count)) {
+		free(points); free(preferred); free(classes);
+		return @[ ];
+	}
+
+	// Store-backed places are read from the store columns,
+	// only the accepted ones get their objects created
+	if ([places isKindOfClass:[TKPlacesStoreArray class]])
+	{
+		TKPlacesStoreArray *stored = (TKPlacesStoreArray *)places;
+		TKPlacesStore *store = stored.store;
+
+		for (NSUInteger idx = 0; idx < count; idx++)
+		{
+			NSUInteger i = [stored storeIndexAtIndex:idx];
+			TKMapPoint mercator = TKMercatorPointForCoordinate([store coordinateAtIndex:i]);
+			points[idx] = (TKMapPoint){ mercator.x * worldSize, mercator.y * worldSize };
+			preferred[idx] = TKSpreadPreferredClassForStored(store, i);
+			classes[idx] = TKSpreadClassNone;
+		}
+	}
+	else [places enumerateObjectsUsingBlock:^(TKPlace *place, NSUInteger idx, BOOL *__unused stop) {
+		TKMapPoint mercator = TKMercatorPointForCoordinate(place.location.coordinate);
+		points[idx] = (TKMapPoint){ mercator.x * worldSize, mercator.y * worldSize };
+		preferred[idx] = TKSpreadPreferredClassForPlace(place);
+		classes[idx] = TKSpreadClassNone;
+	}];
+
+	TKSpreadCandidates(&grid, preferred, points, classes, NULL, count);
+
+	NSMutableArray<TKMapPlaceAnnotation *> *annotations = [NSMutableArray arrayWithCapacity:grid.count];
+
+	for (UInt8 cls = TKSpreadClassFirst; cls <= TKSpreadClassThird; cls++)
+		for (NSUInteger i = 0; i < count; i++)
+		{
+			if (classes[i] != cls) continue;
+			TKMapPlaceAnnotation *anno = [[TKMapPlaceAnnotation alloc] initWithPlace:places[i]];
+			anno.pixelSize = kTKSpreadPixelSizes[cls];
+			[annotations addObject:anno];
+		}
+
+	TKSpreadGridFree(&grid);
+	free(points);
+	free(preferred);
+	free(classes);
+
+	return annotations;
+}
+
++ (void)interpolateNewAnnotations:(NSArray<TKMapPlaceAnnotation *> *)newAnnotations
+                   oldAnnotations:(NSArray<TKMapPlaceAnnotation *> *)oldAnnotations
+                            toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
+                           toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
+                         toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove
+{
+	[self interpolateNewAnnotations:newAnnotations oldAnnotations:oldAnnotations
+		toAdd:toAdd toKeep:toKeep toRestyle:nil toRemove:toRemove];
+}
+
++ (void)interpolateNewAnnotations:(NSArray<TKMapPlaceAnnotation *> *)newAnnotations
+                   oldAnnotations:(NSArray<TKMapPlaceAnnotation *> *)oldAnnotations
+                            toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
+                           toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
+                        toRestyle:(NSMutableArray<TKMapPlaceAnnotation *> *)toRestyle
+                         toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove
+{
+	// Index the requested annotations by place ID, first occurrence wins
+	NSMutableDictionary<NSString *, TKMapPlaceAnnotation *> *requested =
+		[NSMutableDictionary dictionaryWithCapacity:newAnnotations.count];
+
+	for (TKMapPlaceAnnotation *p in newAnnotations)
+	{
+		if (![p isKindOfClass:[TKMapPlaceAnnotation class]]) continue;
+
+		NSString *placeID = p.place.ID;
+		if (placeID && !requested[placeID])
+			requested[placeID] = p;
+	}
+
+	NSMutableSet<NSString *> *displayedIDs = [NSMutableSet setWithCapacity:oldAnnotations.count];
+
+	for (TKMapPlaceAnnotation *p in oldAnnotations)
+	{
+		if (![p isKindOfClass:[TKMapPlaceAnnotation class]]) continue;
+
+		NSString *placeID = p.place.ID;
+		TKMapPlaceAnnotation *n = (placeID) ? requested[placeID] : nil;
+
+		// Not requested any more or a duplicate of an already displayed place
+		if (!n || [displayedIDs containsObject:placeID]) {
+			[toRemove addObject:p];
+			continue;
+		}
+
+		[displayedIDs addObject:placeID];
+
+		if (toRestyle && p.pixelSize != n.pixelSize) {
+			p.pixelSize = n.pixelSize;
+			[toRestyle addObject:p];
+		}
+		else [toKeep addObject:p];
+	}
+
+	for (TKMapPlaceAnnotation *p in newAnnotations)
+	{
+		if (![p isKindOfClass:[TKMapPlaceAnnotation class]]) continue;
+
+		NSString *placeID = p.place.ID;
+		if (placeID && requested[placeID] == p && ![displayedIDs containsObject:placeID])
+			[toAdd addObject:p];
+	}
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark Incremental spreading
+
+
+// Side of the square world tiles placement is evaluated in
+static const double kTKSpreadTileSize = 256;
+
+// Relative world size change considered a zoom change
+static const double kTKSpreadZoomTolerance = 0.01;
+
+typedef struct {
+	int64_t minX, minY;
+	int64_t maxX, maxY;
+} TKSpreadTileRange;
+
+static inline BOOL TKSpreadTileRangeContains(TKSpreadTileRange range, int64_t x, int64_t y)
+{
+	return x >= range.minX && x <= range.maxX && y >= range.minY && y <= range.maxY;
+}
+
+static inline NSNumber *TKSpreadTileKey(int64_t x, int64_t y)
+{
+	return @(((uint64_t)x << 32) | (uint32_t)y);
+}
+
+
+@implementation TKMapAnnotationSpreader
+{
+	NSMutableArray<id> *_sources;
+	NSMutableData *_sourceIndexes;
+	NSMutableSet<NSString *> *_placeIDs;
+	NSMutableData *_mercatorPoints;
+	NSMutableData *_worldPoints;
+	NSMutableData *_preferred;
+	NSMutableData *_classes;
+	NSMutableArray<id> *_annotations;
+
+	double _worldSize;
+	BOOL _hasPlacement;
+	TKSpreadGrid _grid;
+	TKSpreadTileRange _visibleTiles;
+	NSMutableDictionary<NSNumber *, NSMutableIndexSet *> *_tilePlaces;
+	NSMutableSet<NSNumber *> *_evaluatedTiles;
+	NSMutableIndexSet *_pendingPlaces;
+
+	NSMutableDictionary<NSNumber *, TKMapPlaceAnnotation *> *_shownAnnotations;
+	NSMutableArray<TKMapPlaceAnnotation *> *_orphanedAnnotations;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_sources = [NSMutableArray array];
+		_sourceIndexes = [NSMutableData data];
+		_placeIDs = [NSMutableSet set];
+		_mercatorPoints = [NSMutableData data];
+		_worldPoints = [NSMutableData data];
+		_preferred = [NSMutableData data];
+		_classes = [NSMutableData data];
+		_annotations = [NSMutableArray array];
+		_tilePlaces = [NSMutableDictionary dictionary];
+		_evaluatedTiles = [NSMutableSet set];
+		_pendingPlaces = [NSMutableIndexSet indexSet];
+		_shownAnnotations = [NSMutableDictionary dictionary];
+		_orphanedAnnotations = [NSMutableArray array];
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	if (_hasPlacement)
+		TKSpreadGridFree(&_grid);
+}
+
+- (NSArray<TKMapPlaceAnnotation *> *)displayedAnnotations
+{
+	return _shownAnnotations.allValues;
+}
+
+
+#pragma mark Places
+
+
+- (void)addPlaces:(NSArray<TKPlace *> *)places
+{
+	// Store-backed places are added from the store columns,
+	// their objects are created once an annotation is needed
+	if ([places isKindOfClass:[TKPlacesStoreArray class]])
+	{
+		TKPlacesStoreArray *stored = (TKPlacesStoreArray *)places;
+		TKPlacesStore *store = stored.store;
+
+		for (NSUInteger n = 0; n < stored.count; n++)
+		{
+			NSUInteger i = [stored storeIndexAtIndex:n];
+			[self addSource:store index:i ID:[store IDAtIndex:i]
+				coordinate:[store coordinateAtIndex:i] preferredClass:TKSpreadPreferredClassForStored(store, i)];
+		}
+
+		return;
+	}
+
+	for (TKPlace *place in places)
+		[self addSource:place index:0 ID:place.ID
+			coordinate:place.location.coordinate preferredClass:TKSpreadPreferredClassForPlace(place)];
+}
+
+- (void)addSource:(id)source index:(NSUInteger)sourceIndex ID:(NSString *)placeID
+	coordinate:(CLLocationCoordinate2D)coordinate preferredClass:(TKSpreadClass)preferred
+{
+	if (!placeID || [_placeIDs containsObject:placeID]) return;
+
+	NSUInteger idx = _sources.count;
+	TKMapPoint mercator = TKMercatorPointForCoordinate(coordinate);
+	UInt8 cls = TKSpreadClassNone;
+
+	[_sources addObject:source];
+	[_sourceIndexes appendBytes:&sourceIndex length:sizeof(NSUInteger)];
+	[_placeIDs addObject:placeID];
+	[_annotations addObject:[NSNull null]];
+	[_mercatorPoints appendBytes:&mercator length:sizeof(TKMapPoint)];
+	[_preferred appendBytes:&preferred length:sizeof(UInt8)];
+	[_classes appendBytes:&cls length:sizeof(UInt8)];
+
+	TKMapPoint world = { mercator.x * _worldSize, mercator.y * _worldSize };
+	[_worldPoints appendBytes:&world length:sizeof(TKMapPoint)];
+
+	if (!_hasPlacement) return;
+
+	// Places falling into already evaluated tiles are evaluated
+	// on the next update, others once their tile gets evaluated
+	NSNumber *tile = [self tileKeyForPlaceAtIndex:idx];
+	[self bucketPlaceAtIndex:idx tileKey:tile];
+
+	if ([_evaluatedTiles containsObject:tile])
+		[_pendingPlaces addIndex:idx];
+}
+
+- (TKPlace *)placeAtIndex:(NSUInteger)idx
+{
+	id source = _sources[idx];
+
+	if ([source isKindOfClass:[TKPlacesStore class]])
+		return [(TKPlacesStore *)source placeAtIndex:((const NSUInteger *)_sourceIndexes.bytes)[idx]];
+
+	return source;
+}
+
+- (void)removeAllPlaces
+{
+	[_orphanedAnnotations addObjectsFromArray:_shownAnnotations.allValues];
+	[_shownAnnotations removeAllObjects];
+
+	[_sources removeAllObjects];
+	_sourceIndexes.length = 0;
+	[_placeIDs removeAllObjects];
+	[_annotations removeAllObjects];
+	_mercatorPoints.length = 0;
+	_worldPoints.length = 0;
+	_preferred.length = 0;
+	_classes.length = 0;
+
+	[self resetPlacement];
+}
+
+
+#pragma mark Placement
+
+
+- (void)resetPlacement
+{
+	if (_hasPlacement)
+		TKSpreadGridFree(&_grid);
+
+	_hasPlacement = NO;
+	[_tilePlaces removeAllObjects];
+	[_evaluatedTiles removeAllObjects];
+	[_pendingPlaces removeAllIndexes];
+}
+
+- (void)resetPlacementForWorldSize:(double)worldSize
+{
+	[self resetPlacement];
+
+	NSUInteger count = _sources.count;
+
+	if (!TKSpreadGridInit(&_grid, kTKSpreadMinimalDistance, count))
+		return;
+
+	_worldSize = worldSize;
+	_hasPlacement = YES;
+
+	const TKMapPoint *mercator = _mercatorPoints.bytes;
+	TKMapPoint *world = _worldPoints.mutableBytes;
+	UInt8 *classes = _classes.mutableBytes;
+
+	for (NSUInteger i = 0; i < count; i++)
+	{
+		world[i] = (TKMapPoint){ mercator[i].x * worldSize, mercator[i].y * worldSize };
+		classes[i] = TKSpreadClassNone;
+		[self bucketPlaceAtIndex:i tileKey:[self tileKeyForPlaceAtIndex:i]];
+	}
+}
+
+- (NSNumber *)tileKeyForPlaceAtIndex:(NSUInteger)idx
+{
+	TKMapPoint point = ((const TKMapPoint *)_worldPoints.bytes)[idx];
+
+	return TKSpreadTileKey((int64_t)floor(point.x / kTKSpreadTileSize),
+		(int64_t)floor(point.y / kTKSpreadTileSize));
+}
+
+- (void)bucketPlaceAtIndex:(NSUInteger)idx tileKey:(NSNumber *)tile
+{
+	NSMutableIndexSet *indexes = _tilePlaces[tile];
+
+	if (!indexes) _tilePlaces[tile] = indexes = [NSMutableIndexSet indexSet];
+
+	[indexes addIndex:idx];
+}
+
+- (TKSpreadTileRange)tileRangeForRegion:(MKCoordinateRegion)region mapViewSize:(CGSize)size
+{
+	TKMapPoint center = TKMercatorPointForCoordinate(region.center);
+	double centerX = center.x * _worldSize, centerY = center.y * _worldSize;
+	double halfWidth = MAX(size.width, 1) / 2, halfHeight = MAX(size.height, 1) / 2;
+	double maxTile = MAX(ceil(_worldSize / kTKSpreadTileSize) - 1, 0);
+
+	// Keep a single tile margin around the viewport for smooth panning
+	return (TKSpreadTileRange){
+		.minX = (int64_t)MINMAX(0, floor((centerX - halfWidth) / kTKSpreadTileSize) - 1, maxTile),
+		.minY = (int64_t)MINMAX(0, floor((centerY - halfHeight) / kTKSpreadTileSize) - 1, maxTile),
+		.maxX = (int64_t)MINMAX(0, floor((centerX + halfWidth) / kTKSpreadTileSize) + 1, maxTile),
+		.maxY = (int64_t)MINMAX(0, floor((centerY + halfHeight) / kTKSpreadTileSize) + 1, maxTile),
+	};
+}
+
+- (void)evaluatePlacesAtIndexes:(NSIndexSet *)indexes
+{
+	NSUInteger count = indexes.count;
+
+	if (!count) return;
+
+	NSUInteger *buffer = malloc(count * sizeof(NSUInteger));
+	if (!buffer) return;
+
+	[indexes getIndexes:buffer maxCount:count inIndexRange:NULL];
+
+	UInt8 *classes = _classes.mutableBytes;
+
+	TKSpreadCandidates(&_grid, _preferred.bytes, _worldPoints.bytes, classes, buffer, count);
+
+	for (NSUInteger n = 0; n < count; n++)
+	{
+		NSUInteger i = buffer[n];
+		if (classes[i] == TKSpreadClassNone) continue;
+
+		// Reuse the annotation instance when the place keeps its size
+		double pixelSize = kTKSpreadPixelSizes[classes[i]];
+		TKMapPlaceAnnotation *anno = _annotations[i];
+
+		if (![anno isKindOfClass:[TKMapPlaceAnnotation class]] || anno.pixelSize != pixelSize) {
+			anno = [[TKMapPlaceAnnotation alloc] initWithPlace:[self placeAtIndex:i]];
+			anno.pixelSize = pixelSize;
+			_annotations[i] = anno;
+		}
+	}
+
+	free(buffer);
+}
+
+- (void)collectAcceptedPlacesInTile:(NSNumber *)tile into:(NSMutableIndexSet *)indexes
+{
+	const UInt8 *classes = _classes.bytes;
+
+	[_tilePlaces[tile] enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *__unused stop) {
+		if (classes[idx] != TKSpreadClassNone)
+			[indexes addIndex:idx];
+	}];
+}
+
+
+#pragma mark Updates
+
+
+- (void)updateForRegion:(MKCoordinateRegion)region mapViewSize:(CGSize)size
+                  toAdd:(NSMutableArray<TKMapPlaceAnnotation *> *)toAdd
+                 toKeep:(NSMutableArray<TKMapPlaceAnnotation *> *)toKeep
+               toRemove:(NSMutableArray<TKMapPlaceAnnotation *> *)toRemove
+{
+	[toRemove addObjectsFromArray:_orphanedAnnotations];
+	[_orphanedAnnotations removeAllObjects];
+
+	double worldSize = TKSpreadWorldSizeForRegion(region, size);
+
+	// Minimal distance is constant in world pixels, any zoom change
+	// therefore invalidates the whole placement
+	BOOL zoomChanged = !_hasPlacement ||
+		fabs(worldSize / _worldSize - 1) > kTKSpreadZoomTolerance;
+
+	TKSpreadTileRange previousTiles = _visibleTiles;
+
+	if (zoomChanged)
+		[self resetPlacementForWorldSize:worldSize];
+
+	if (!_hasPlacement) {
+		[toRemove addObjectsFromArray:_shownAnnotations.allValues];
+		[_shownAnnotations removeAllObjects];
+		return;
+	}
+
+	TKSpreadTileRange visibleTiles = [self tileRangeForRegion:region mapViewSize:size];
+	_visibleTiles = visibleTiles;
+
+	NSMutableIndexSet *displayed = [NSMutableIndexSet indexSet];
+
+	if (!zoomChanged)
+	{
+		for (NSNumber *idx in _shownAnnotations)
+			[displayed addIndex:idx.unsignedIntegerValue];
+
+		// Drop places of tiles which have left the viewport
+		for (int64_t y = previousTiles.minY; y <= previousTiles.maxY; y++)
+			for (int64_t x = previousTiles.minX; x <= previousTiles.maxX; x++)
+				if (!TKSpreadTileRangeContains(visibleTiles, x, y))
+					[displayed removeIndexes:_tilePlaces[TKSpreadTileKey(x, y)] ?: [NSIndexSet indexSet]];
+	}
+
+	// Evaluate tiles which have entered the viewport for the first time
+	// together with places recently added to already evaluated tiles
+	NSMutableArray<NSNumber *> *enteredTiles = [NSMutableArray array];
+	NSMutableIndexSet *candidates = [_pendingPlaces mutableCopy];
+
+	for (int64_t y = visibleTiles.minY; y <= visibleTiles.maxY; y++)
+		for (int64_t x = visibleTiles.minX; x <= visibleTiles.maxX; x++)
+		{
+			if (!zoomChanged && TKSpreadTileRangeContains(previousTiles, x, y)) continue;
+
+			NSNumber *tile = TKSpreadTileKey(x, y);
+			[enteredTiles addObject:tile];
+
+			if ([_evaluatedTiles containsObject:tile]) continue;
+
+			[_evaluatedTiles addObject:tile];
+			[candidates addIndexes:_tilePlaces[tile] ?: [NSIndexSet indexSet]];
+		}
+
+	[_pendingPlaces removeAllIndexes];
+	[self evaluatePlacesAtIndexes:candidates];
+
+	for (NSNumber *tile in enteredTiles)
+		[self collectAcceptedPlacesInTile:tile into:displayed];
+
+	const UInt8 *classes = _classes.bytes;
+
+	[candidates enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *__unused stop) {
+		if (classes[idx] == TKSpreadClassNone) return;
+		TKMapPoint point = ((const TKMapPoint *)self->_worldPoints.bytes)[idx];
+		if (TKSpreadTileRangeContains(visibleTiles, (int64_t)floor(point.x / kTKSpreadTileSize),
+		    (int64_t)floor(point.y / kTKSpreadTileSize)))
+			[displayed addIndex:idx];
+	}];
+
+	// Emit the deltas against the previously shown annotations
+	NSMutableDictionary<NSNumber *, TKMapPlaceAnnotation *> *shown =
+		[NSMutableDictionary dictionaryWithCapacity:displayed.count];
+
+	[displayed enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *__unused stop) {
+		shown[@(idx)] = self->_annotations[idx];
+	}];
+
+	[_shownAnnotations enumerateKeysAndObjectsUsingBlock:
+	  ^(NSNumber *idx, TKMapPlaceAnnotation *anno, BOOL *__unused stop) {
+		if (shown[idx] == anno) [toKeep addObject:anno];
+		else [toRemove addObject:anno];
+	}];
+
+	[shown enumerateKeysAndObjectsUsingBlock:
+	  ^(NSNumber *idx, TKMapPlaceAnnotation *anno, BOOL *__unused stop) {
+		if (self->_shownAnnotations[idx] != anno) [toAdd addObject:anno];
+	}];
+
+	_shownAnnotations = shown;
+}
+
+@end
+
+
+#pragma mark -
+#pragma mark Simplified polyline
+
+
+@implementation TKSimplifiedPolyline
+{
+	CLLocationCoordinate2D *_coordinates;
+	UInt8 *_minZooms;
+	NSMutableDictionary<NSNumber *, NSData *> *_levelIndexes;
+}
+
+- (instancetype)initWithPolyline:(NSString *)polyline
+{
+	const char *bytes = ([polyline isKindOfClass:[NSString class]]) ? polyline.UTF8String : NULL;
+	NSUInteger length = (bytes) ? strlen(bytes) : 0;
+	NSUInteger count = TKPolylineDecodedCount(bytes, length);
+
+	CLLocationCoordinate2D *coordinates = (count) ? malloc(count * sizeof(CLLocationCoordinate2D)) : NULL;
+
+	if (coordinates) count = TKPolylineDecode(bytes, length, coordinates, count);
+	if (!coordinates || count == NSNotFound) count = 0;
+
+	self = [self initWithCoordinates:coordinates count:count];
+
+	free(coordinates);
+
+	return self;
+}
+
+- (instancetype)initWithCoordinates:(const CLLocationCoordinate2D *)coordinates count:(NSUInteger)count
+{
+	if (self = [super init])
+	{
+		_coordinates = (count) ? malloc(count * sizeof(CLLocationCoordinate2D)) : NULL;
+		_minZooms = (count) ? malloc(count * sizeof(UInt8)) : NULL;
+		_levelIndexes = [NSMutableDictionary dictionary];
+
+		if (_coordinates && _minZooms) {
+			memcpy(_coordinates, coordinates, count * sizeof(CLLocationCoordinate2D));
+			TKPolylineRankVertices(_coordinates, count, _minZooms);
+			_count = count;
+		}
+	}
+
+	return self;
+}
+
+- (void)dealloc
+{
+	free(_coordinates);
+	free(_minZooms);
+}
+
+- (NSData *)indexesForLevel:(UInt8)level
+{
+	@synchronized (self) {
+
+		NSData *indexes = _levelIndexes[@(level)];
+
+		if (!indexes)
+		{
+			NSMutableData *data = [NSMutableData dataWithCapacity:_count * sizeof(UInt32)];
+
+			for (UInt32 i = 0; i < _count; i++)
+				if (_minZooms[i] <= level)
+					[data appendBytes:&i length:sizeof(UInt32)];
+
+			_levelIndexes[@(level)] = indexes = data;
+		}
+
+		return indexes;
+	}
+}
+
+- (NSUInteger)getCoordinates:(CLLocationCoordinate2D *)coordinates
+	capacity:(NSUInteger)capacity zoomLevel:(double)zoomLevel
+{
+	if (!_count) return 0;
+
+	UInt8 level = (UInt8)MINMAX(0, ceil(zoomLevel), TK_QUADKEY_MAX_LEVEL);
+
+	// Full resolution on the deepest level, no need for an index list
+	if (level >= TK_QUADKEY_MAX_LEVEL) {
+		if (coordinates) memcpy(coordinates, _coordinates, MIN(_count, capacity) * sizeof(CLLocationCoordinate2D));
+		return _count;
+	}
+
+	NSData *indexes = [self indexesForLevel:level];
+	const UInt32 *idx = indexes.bytes;
+	NSUInteger total = indexes.length / sizeof(UInt32);
+
+	if (coordinates)
+		for (NSUInteger i = 0; i < MIN(total, capacity); i++)
+			coordinates[i] = _coordinates[idx[i]];
+
+	return total;
+}
+
+- (NSArray<CLLocation *> *)pointsForZoomLevel:(double)zoomLevel
+{
+	NSUInteger total = [self getCoordinates:NULL capacity:0 zoomLevel:zoomLevel];
+
+	if (!total) return @[ ];
+
+	CLLocationCoordinate2D *coordinates = malloc(total * sizeof(CLLocationCoordinate2D));
+
+	if (!coordinates) return @[ ];
+
+	total = MIN(total, [self getCoordinates:coordinates capacity:total zoomLevel:zoomLevel]);
+
+	NSMutableArray<CLLocation *> *points = [NSMutableArray arrayWithCapacity:total];
+
+	for (NSUInteger i = 0; i < total; i++)
+		[points addObject:[[CLLocation alloc] initWithLatitude:coordinates[i].latitude
+		                                             longitude:coordinates[i].longitude]];
+
+	free(coordinates);
+
+	return points;
 }
 
 @end
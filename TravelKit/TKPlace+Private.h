@@ -8,10 +8,17 @@
 
 #import <TravelKit/TKPlace.h>
 
+#import "TKMapWorker+Private.h"
+
 NS_ASSUME_NONNULL_BEGIN
 
+@class TKPlacesStore;
+
 @interface TKPlace ()
 
+/// Packed representation of the `quadKey`
+@property (atomic, readonly) TKQuadKey packedQuadKey;
+
 /// Dictionary with @(TKPlaceLevel) key and NSString* values
 + (NSDictionary<NSNumber *, NSString *> *)levelStrings;
 
@@ -24,6 +31,9 @@ NS_ASSUME_NONNULL_BEGIN
 /// Initialiser
 - (nullable instancetype)initFromResponse:(NSDictionary *)response;
 
+/// Initialiser reading the attributes of a stored place
+- (nullable instancetype)initFromStore:(TKPlacesStore *)store index:(NSUInteger)index;
+
 @end
 
 
@@ -8,9 +8,9 @@
 
 #import <TravelKit/Foundation+TravelKit.h>
 #import <TravelKit/NSObject+Parsing.h>
-#import <TravelKit/TKMapWorker.h>
 
 #import "TKPlace+Private.h"
+#import "TKPlacesStore+Private.h"
 #import "TKMedium+Private.h"
 #import "TKReference+Private.h"
 
@@ -129,9 +129,11 @@
 			if (thumbURL) _thumbnailURL = thumbURL;
 		}
 
-		_quadKey = [dictionary[@"quadkey"] parsedString];
-		if (!_quadKey && _location)
-			_quadKey = [TKMapWorker quadKeyForCoordinate:_location.coordinate detailLevel:18];
+		// Quad key is kept packed, string is only built when asked for
+		NSString *quadKey = [dictionary[@"quadkey"] parsedString];
+		_packedQuadKey = TKQuadKeyFromString(quadKey);
+		if (_packedQuadKey != TKQuadKeyInvalid) _quadKey = quadKey;
+		else _packedQuadKey = TKQuadKeyMake(TKQuadKeyBitsForCoordinate(_location.coordinate, 18), 18);
 
 		// Bounding box
 		if ((location = [dictionary[@"bounding_box"] parsedDictionary]))
@@ -183,6 +185,59 @@
 	return self;
 }
 
+- (instancetype)initFromStore:(TKPlacesStore *)store index:(NSUInteger)index
+{
+	if (self = [super init])
+	{
+		_ID = [store IDAtIndex:index];
+		_name = [store nameAtIndex:index];
+		_suffix = [store suffixAtIndex:index];
+		_perex = [store perexAtIndex:index];
+		_level = [store levelAtIndex:index];
+
+		CLLocationCoordinate2D coordinate = [store coordinateAtIndex:index];
+		_location = [[CLLocation alloc] initWithLatitude:coordinate.latitude longitude:coordinate.longitude];
+
+		NSString *thumbnail = [store thumbnailAtIndex:index];
+		if (thumbnail) _thumbnailURL = [NSURL URLWithString:thumbnail];
+
+		// Quad key string is built when asked for
+		_packedQuadKey = [store quadKeyAtIndex:index];
+
+		_boundingBox = [store boundingBoxAtIndex:index];
+
+		float rating = [store ratingAtIndex:index];
+		if (!isnan(rating)) _rating = @(rating);
+
+		_parents = [store parentsAtIndex:index] ?: @[ ];
+
+		_kind = [store kindAtIndex:index];
+		_marker = [store markerAtIndex:index];
+		if ([_marker isEqualToString:@"default"])
+			_marker = nil;
+
+		_categories = [store categoriesAtIndex:index];
+
+		TKPlacesStoreFlags storeFlags = [store flagsAtIndex:index];
+		NSMutableArray<NSString *> *flags = [NSMutableArray arrayWithCapacity:2];
+
+		if (storeFlags & TKPlacesStoreFlagWikipediaDescription)
+			[flags addObject:@"wikipedia_description"];
+
+		if (storeFlags & TKPlacesStoreFlagShapeGeometry)
+			[flags addObject:@"has_geometry"];
+
+		_flags = flags;
+	}
+
+	return self;
+}
+
+- (NSString *)quadKey
+{
+	return _quadKey ?: TKQuadKeyToString(_packedQuadKey);
+}
+
 - (NSUInteger)displayableHexColor
 {
 	TKPlaceCategory cat = _categories;
@@ -16,6 +16,22 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+///---------------------------------------------------------------------------------------
+/// @name Places Viewport
+///---------------------------------------------------------------------------------------
+
+/**
+ A map viewport tracking tiled Places queries made for a single map view.
+
+ Each query made for a viewport moves it to the tiles of the query. Earlier queries of the same
+ viewport not overlapping the new tiles are superseded -- their pending requests are cancelled
+ unless shared with other callers, they get no further preview and complete with an
+ `NSURLErrorCancelled` error. Queries made for other viewports or without any are not affected.
+ */
+@interface TKPlacesViewport : NSObject
+@end
+
+
 ///---------------------------------------------------------------------------------------
 /// @name Places Manager
 ///---------------------------------------------------------------------------------------
@@ -50,13 +66,57 @@ NS_ASSUME_NONNULL_BEGIN
 - (void)placesForQuery:(TKPlacesQuery *)query
 	completion:(void (^)(NSArray<TKPlace *>  * _Nullable places, NSError * _Nullable error))completion;
 
+/**
+ Returns a collection of `TKPlace` objects for the given query object, providing a preview first.
+
+ When the result is not cached, the preview block is called at most once with places derived
+ from cached tiles of lower detail or from expired records, before the precise result arrives.
+
+ @param query `TKPlacesQuery` object containing the desired attributes to look for.
+ @param preview Block called with an approximate collection of Places. Optional.
+ @param completion Completion block called on success or error.
+ */
+- (void)placesForQuery:(TKPlacesQuery *)query
+	preview:(nullable void (^)(NSArray<TKPlace *> *places))preview
+	completion:(void (^)(NSArray<TKPlace *>  * _Nullable places, NSError * _Nullable error))completion;
+
+/**
+ Returns a collection of `TKPlace` objects for the given query object made for a map viewport.
+
+ Works as `-placesForQuery:preview:completion:`, queries for `quadKeys` are additionally tracked
+ by the given viewport. Once the map moves away from the tiles of a query, the query is cancelled,
+ see `TKPlacesViewport`.
+
+ @param query `TKPlacesQuery` object containing the desired attributes to look for.
+ @param viewport Viewport of the map the query is made for. Optional.
+ @param preview Block called with an approximate collection of Places. Optional.
+ @param completion Completion block called on success or error.
+ */
+- (void)placesForQuery:(TKPlacesQuery *)query viewport:(nullable TKPlacesViewport *)viewport
+	preview:(nullable void (^)(NSArray<TKPlace *> *places))preview
+	completion:(void (^)(NSArray<TKPlace *>  * _Nullable places, NSError * _Nullable error))completion;
+
+/**
+ Returns a collection of `TKPlace` objects for the given query object, optimised for map use.
+
+ Places are decoded into a compact storage as the response arrives and the `TKPlace` objects
+ are only created once accessed, which keeps large results cheap when passed straight
+ to `TKMapWorker` for spreading. Results are kept in memory, but not persisted.
+
+ @param query `TKPlacesQuery` object containing the desired attributes to look for.
+ @param completion Completion block called on success or error.
+ */
+- (void)mapPlacesForQuery:(TKPlacesQuery *)query
+	completion:(void (^)(NSArray<TKPlace *>  * _Nullable places, NSError * _Nullable error))completion;
+
 /**
  Returns a collection of `TKPlace` objects for the given IDs.
 
  @param placeIDs Array of strings matching desired Place IDs.
  @param completion Completion block called on success or error.
 
- @note Only a maximum number or `32` IDs will be processed.
+ @note Lookups issued within a short time window are fetched together
+       in batches of up to `32` IDs.
 
  */
 - (void)detailedPlacesWithIDs:(NSArray<NSString *> *)placeIDs
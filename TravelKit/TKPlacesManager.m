@@ -7,7 +7,388 @@
 //
 
 #import <TravelKit/TKPlacesManager.h>
+#import <TravelKit/Foundation+TravelKit.h>
+
 #import "TKAPI+Private.h"
+#import "TKPlace+Private.h"
+#import "TKPlacesTileCache+Private.h"
+#import "TKPlacesStore+Private.h"
+#import "TKPlacesQuery+Private.h"
+#import "TKCanonicalEncoder+Private.h"
+
+
+/// Places cache key built from a digest of the query without tiles and a packed tile key
+static NSString *TKPlacesCacheKey(NSString *querySignature, TKQuadKey tile)
+{
+	return [NSString stringWithFormat:@"%@|%llx", querySignature, tile];
+}
+
+/// Single-flight key of a places query tile
+static NSString *TKPlacesFlightKey(NSString *cacheKey)
+{
+	return [@"places|" stringByAppendingString:cacheKey];
+}
+
+/// Single-flight key of a detailed place, shared by single and batch requests
+static NSString *TKPlaceFlightKey(NSString *placeID)
+{
+	return [@"place|" stringByAppendingString:placeID];
+}
+
+/// Freshness lifetime given by the `max-age` directive of the response, `0` if missing
+static NSTimeInterval TKPlacesMaxAge(TKAPIResponse *response)
+{
+	NSString *cacheControl = [response valueForHeaderField:@"Cache-Control"];
+
+	for (NSString *directive in [cacheControl componentsSeparatedByString:@","])
+	{
+		NSString *trimmed = [directive stringByTrimmingCharactersInSet:
+			[NSCharacterSet whitespaceCharacterSet]].lowercaseString;
+		if ([trimmed hasPrefix:@"max-age="])
+			return MAX([trimmed substringFromIndex:8].doubleValue, 0);
+	}
+
+	return 0;
+}
+
+/// Calls the block once the group is done, on the API response queue the completions
+/// of the manager are called on
+static void TKPlacesNotifyGroup(dispatch_group_t group, dispatch_block_t block)
+{
+	dispatch_group_notify(group, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^{
+		[[TKAPIRequest responseQueue] addOperationWithBlock:block];
+	});
+}
+
+static NSArray<TKPlace *> *TKPlacesSortedByRating(NSArray<TKPlace *> *places)
+{
+	return [places sortedArrayUsingComparator:^NSComparisonResult(TKPlace *lhs, TKPlace *rhs) {
+		return [rhs.rating ?: @0 compare:lhs.rating ?: @0];
+	}];
+}
+
+// Number of ancestor levels looked up for a reusable tile record
+static const UInt8 kTKPlacesAncestorLevels = 3;
+
+static TKPlacesTileRecord *TKPlacesMakeRecord(NSString *cacheKey, NSArray<TKPlace *> *places,
+	BOOL complete, NSDate *expirationDate)
+{
+	TKPlacesTileRecord *record = [TKPlacesTileRecord new];
+	record.key = cacheKey;
+	record.places = places;
+	record.complete = complete;
+	record.expirationDate = expirationDate;
+	return record;
+}
+
+/// Expiration of results given by the `max-age` of the response, the tile cache default if missing
+static NSDate *TKPlacesExpirationDate(TKAPIResponse *_Nullable response)
+{
+	NSTimeInterval maxAge = (response) ? TKPlacesMaxAge(response) : 0;
+	if (maxAge <= 0) maxAge = [TKPlacesTileCache sharedCache].defaultTimeToLive;
+
+	return [NSDate dateWithTimeIntervalSinceNow:maxAge];
+}
+
+/// States whether the response holds all places of the requested tiles matching the query
+static BOOL TKPlacesResponseIsComplete(TKPlacesQuery *query, NSUInteger count)
+{
+	// Spread and paged results are only a selection of the matching places
+	if (query.mapSpread.intValue > 0 || query.offset.intValue > 0)
+		return NO;
+
+	// Without an explicit limit the page size is up to the API and a full page cannot be told apart
+	if (query.limit.intValue <= 0)
+		return NO;
+
+	return (NSInteger)count < query.limit.integerValue;
+}
+
+static NSArray<TKPlace *> *TKPlacesInTile(NSArray<TKPlace *> *places, TKQuadKey tile)
+{
+	if (!places.count) return @[ ];
+
+	return [places filteredArrayUsingBlock:^BOOL(TKPlace *place) {
+		return TKQuadKeyHasPrefix(place.packedQuadKey, tile);
+	}];
+}
+
+/// Closest record of the tile ancestors provided by the lookup block, complete records preferred
+static TKPlacesTileRecord *TKPlacesAncestorRecord(NSString *querySignature, TKQuadKey tile,
+	TKPlacesTileRecord *(^lookup)(NSString *cacheKey))
+{
+	if (tile == TKQuadKeyInvalid) return nil;
+
+	TKPlacesTileRecord *closest = nil;
+	int level = TKQuadKeyLevel(tile);
+
+	for (int l = level - 1; l >= 1 && l >= level - kTKPlacesAncestorLevels; l--)
+	{
+		TKQuadKey ancestor = TKQuadKeyAncestor(tile, (UInt8)l);
+		TKPlacesTileRecord *record = lookup(TKPlacesCacheKey(querySignature, ancestor));
+
+		if (record.complete) return record;
+		if (!closest) closest = record;
+	}
+
+	return closest;
+}
+
+/// Whether any tile of the first packed set overlaps any tile of the second one
+static BOOL TKPlacesTilesIntersect(NSData *tiles, NSData *otherTiles)
+{
+	const TKQuadKey *lhs = tiles.bytes, *rhs = otherTiles.bytes;
+	NSUInteger lhsCount = tiles.length / sizeof(TKQuadKey);
+	NSUInteger rhsCount = otherTiles.length / sizeof(TKQuadKey);
+
+	for (NSUInteger i = 0; i < lhsCount; i++)
+		for (NSUInteger j = 0; j < rhsCount; j++)
+			if (TKQuadKeyHasPrefix(lhs[i], rhs[j]) || TKQuadKeyHasPrefix(rhs[j], lhs[i]))
+				return YES;
+
+	return NO;
+}
+
+
+@class TKDetailedPlacesBatcher;
+
+@interface TKPlacesManager ()
+
+@property (nonatomic, strong) TKDetailedPlacesBatcher *detailsBatcher;
+
++ (NSCache<NSString *, TKDetailedPlace *> *)detailedPlaceCache;
+
+@end
+
+
+#pragma mark - Places viewport -
+
+
+/// Request made for a viewport along with the tiles and flights it serves
+@interface TKPlacesViewportRequest : NSObject
+
+@property (nonatomic, strong) TKAPIRequest *request;
+@property (nonatomic, copy) NSData *tiles;
+@property (nonatomic, copy) NSArray<NSString *> *flightKeys;
+
+@end
+
+@implementation TKPlacesViewportRequest
+@end
+
+
+@interface TKPlacesViewport ()
+
+// Tiles of the latest query made for the viewport
+@property (nonatomic, copy) NSData *tiles;
+@property (nonatomic, strong) NSMutableArray<TKPlacesViewportRequest *> *requests;
+
+@end
+
+@implementation TKPlacesViewport
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_requests = [NSMutableArray arrayWithCapacity:8];
+	}
+
+	return self;
+}
+
+- (void)moveToTiles:(NSData *)tiles
+{
+	NSMutableArray<TKAPIRequest *> *superseded = [NSMutableArray array];
+	TKAPIRequestCoalescer *coalescer = [TKAPIRequestCoalescer sharedCoalescer];
+
+	@synchronized (self) {
+
+		_tiles = [tiles copy];
+
+		NSMutableIndexSet *removed = [NSMutableIndexSet indexSet];
+
+		[_requests enumerateObjectsUsingBlock:^(TKPlacesViewportRequest *entry, NSUInteger idx, BOOL *__unused stop) {
+
+			if (TKPlacesTilesIntersect(entry.tiles, tiles)) return;
+
+			[removed addIndex:idx];
+
+			// Requests awaited by other callers are left running
+			for (NSString *flightKey in entry.flightKeys)
+				if ([coalescer isFlightWithKeyJoined:flightKey]) return;
+
+			[superseded addObject:entry.request];
+		}];
+
+		[_requests removeObjectsAtIndexes:removed];
+	}
+
+	// Requests are cancelled outside of the lock as they may fail synchronously
+	for (TKAPIRequest *request in superseded)
+		[request cancel];
+}
+
+- (BOOL)intersectsTiles:(NSData *)tiles
+{
+	@synchronized (self) {
+		return TKPlacesTilesIntersect(tiles, _tiles);
+	}
+}
+
+- (void)addRequest:(TKAPIRequest *)request tiles:(NSData *)tiles flightKeys:(NSArray<NSString *> *)flightKeys
+{
+	TKPlacesViewportRequest *entry = [TKPlacesViewportRequest new];
+	entry.request = request;
+	entry.tiles = tiles;
+	entry.flightKeys = flightKeys;
+
+	@synchronized (self) {
+		[_requests addObject:entry];
+	}
+}
+
+- (void)removeRequest:(TKAPIRequest *)request
+{
+	if (!request) return;
+
+	@synchronized (self) {
+		NSUInteger idx = [_requests indexOfObjectPassingTest:
+		  ^BOOL(TKPlacesViewportRequest *entry, NSUInteger __unused i, BOOL *__unused stop) {
+			return entry.request == request;
+		}];
+		if (idx != NSNotFound) [_requests removeObjectAtIndex:idx];
+	}
+}
+
+@end
+
+
+#pragma mark - Detailed places batcher -
+
+
+// Maximal number of IDs accepted by the places batch endpoint
+static const NSUInteger kTKPlacesBatchMaximumSize = 32;
+
+/**
+ Collects individual detailed place lookups over a short window
+ and fetches them using the places batch endpoint.
+ */
+@interface TKDetailedPlacesBatcher : NSObject
+
+/// Time interval lookups are collected for before being sent. Defaults to 10 ms.
+@property (atomic) NSTimeInterval window;
+
+/// Number of collected IDs sending the batch immediately. Defaults to the batch endpoint maximum.
+@property (atomic) NSUInteger maximumBatchSize;
+
+- (void)fetchPlaceWithID:(NSString *)placeID completion:(TKAPIFlightCompletion)completion;
+
+@end
+
+@implementation TKDetailedPlacesBatcher
+{
+	dispatch_queue_t _queue;
+	NSMutableArray<NSString *> *_pendingIDs;
+	NSMutableDictionary<NSString *, NSMutableArray<TKAPIFlightCompletion> *> *_pendingCompletions;
+	NSUInteger _generation;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_queue = dispatch_queue_create("TravelKit.DetailedPlacesBatcher", DISPATCH_QUEUE_SERIAL);
+		_pendingIDs = [NSMutableArray arrayWithCapacity:kTKPlacesBatchMaximumSize];
+		_pendingCompletions = [NSMutableDictionary dictionaryWithCapacity:kTKPlacesBatchMaximumSize];
+		_window = 0.010;
+		_maximumBatchSize = kTKPlacesBatchMaximumSize;
+	}
+
+	return self;
+}
+
+- (void)fetchPlaceWithID:(NSString *)placeID completion:(TKAPIFlightCompletion)completion
+{
+	completion = [completion copy];
+
+	dispatch_async(_queue, ^{
+
+		NSMutableArray<TKAPIFlightCompletion> *completions = self->_pendingCompletions[placeID];
+
+		if (!completions) {
+			completions = [NSMutableArray arrayWithCapacity:1];
+			self->_pendingCompletions[placeID] = completions;
+			[self->_pendingIDs addObject:placeID];
+		}
+
+		if (completion) [completions addObject:completion];
+
+		if (self->_pendingIDs.count >= MAX(self.maximumBatchSize, 1)) {
+			[self flush];
+			return;
+		}
+
+		// First lookup of a batch schedules sending it
+		if (self->_pendingIDs.count == 1)
+		{
+			NSUInteger generation = self->_generation;
+			dispatch_time_t time = dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.window * NSEC_PER_SEC));
+
+			dispatch_after(time, self->_queue, ^{
+				if (self->_generation == generation) [self flush];
+			});
+		}
+	});
+}
+
+- (void)flush
+{
+	// Invalidate the scheduled send of the batch
+	_generation++;
+
+	NSArray<NSString *> *placeIDs = [_pendingIDs copy];
+	NSDictionary<NSString *, NSArray<TKAPIFlightCompletion> *> *completions = [_pendingCompletions copy];
+
+	[_pendingIDs removeAllObjects];
+	[_pendingCompletions removeAllObjects];
+
+	NSCache<NSString *, TKDetailedPlace *> *placeCache = [TKPlacesManager detailedPlaceCache];
+
+	for (NSUInteger i = 0; i < placeIDs.count; i += kTKPlacesBatchMaximumSize)
+	{
+		NSArray<NSString *> *chunk = [placeIDs subarrayWithRange:
+			NSMakeRange(i, MIN(kTKPlacesBatchMaximumSize, placeIDs.count - i))];
+
+		[[[TKAPIRequest alloc] initAsPlacesRequestForIDs:chunk success:^(NSArray<TKDetailedPlace *> *places) {
+
+			NSMutableDictionary<NSString *, TKDetailedPlace *> *placesByID =
+				[NSMutableDictionary dictionaryWithCapacity:places.count];
+
+			for (TKDetailedPlace *p in places) {
+				[placeCache setObject:p forKey:p.ID];
+				placesByID[p.ID] = p;
+			}
+
+			// Places left out of the response resolve with neither a place nor an error
+			for (NSString *placeID in chunk)
+				for (TKAPIFlightCompletion completion in completions[placeID])
+					completion(placesByID[placeID], nil);
+
+		} failure:^(TKAPIError *error) {
+
+			for (NSString *placeID in chunk)
+				for (TKAPIFlightCompletion completion in completions[placeID])
+					completion(nil, error);
+
+		}] start];
+	}
+}
+
+@end
+
+
+#pragma mark - Places manager -
 
 
 @implementation TKPlacesManager
@@ -32,7 +413,9 @@
 - (instancetype)init
 {
 	if (self = [super init])
-	{}
+	{
+		_detailsBatcher = [TKDetailedPlacesBatcher new];
+	}
 
 	return self;
 }
@@ -50,6 +433,32 @@
 	return placeCache;
 }
 
++ (NSCache<NSString *, TKPlacesTileRecord *> *)tileRecordCache
+{
+	static NSCache<NSString *, TKPlacesTileRecord *> *recordCache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		recordCache = [NSCache new];
+		recordCache.countLimit = 256;
+	});
+
+	return recordCache;
+}
+
++ (NSCache<NSString *, TKPlacesStore *> *)placesStoreCache
+{
+	static NSCache<NSString *, TKPlacesStore *> *storeCache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		storeCache = [NSCache new];
+		storeCache.countLimit = 32;
+	});
+
+	return storeCache;
+}
+
 + (NSCache<NSString *, TKDetailedPlace *> *)detailedPlaceCache
 {
 	static NSCache<NSString *, TKDetailedPlace *> *placeCache = nil;
@@ -70,146 +479,517 @@
 
 - (void)placesForQuery:(TKPlacesQuery *)query completion:(void (^)(NSArray<TKPlace *> *, NSError *))completion
 {
-	static NSCache<NSNumber *, NSArray<TKPlace *> *> *placesCache = nil;
+	[self placesForQuery:query preview:nil completion:completion];
+}
 
-	static dispatch_once_t onceToken;
-	dispatch_once(&onceToken, ^{
-		placesCache = [NSCache new];
-		placesCache.countLimit = 256;
-	});
+- (void)placesForQuery:(TKPlacesQuery *)query preview:(void (^)(NSArray<TKPlace *> *))preview
+	completion:(void (^)(NSArray<TKPlace *> *, NSError *))completion
+{
+	[self placesForQuery:query viewport:nil preview:preview completion:completion];
+}
+
+- (void)placesForQuery:(TKPlacesQuery *)query viewport:(TKPlacesViewport *)viewport
+	preview:(void (^)(NSArray<TKPlace *> *))preview completion:(void (^)(NSArray<TKPlace *> *, NSError *))completion
+{
+	NSCache<NSString *, TKPlacesTileRecord *> *recordCache = [self.class tileRecordCache];
 
-	if (query.quadKeys.count <= 1)
+	// Query without tiles is shared by all per-tile cache records
+	TKPlacesQuery *workingQuery = [query copy];
+	workingQuery.quadKeys = nil;
+
+	TKCanonicalEncoder *encoder = [TKCanonicalEncoder new];
+	[encoder encodeString:[TKAPI sharedAPI].languageID forField:1];
+	[encoder encodeData:workingQuery.canonicalData forField:2];
+
+	NSString *querySignature = encoder.digest;
+
+	if (!query.quadKeys.count)
 	{
-		NSArray *cached = [placesCache objectForKey:@(query.hash)];
-		if (cached) {
+		NSString *cacheKey = TKPlacesCacheKey(querySignature, TKQuadKeyInvalid);
+		TKPlacesTileRecord *cached = [recordCache objectForKey:cacheKey];
+		if (cached && !cached.expired) {
 			if (completion)
-				completion(cached, nil);
+				completion(cached.places, nil);
 			return;
 		}
+
+		[[TKAPIRequestCoalescer sharedCoalescer] performFlightWithKey:TKPlacesFlightKey(cacheKey)
+		  start:^(TKAPIFlightCompletion finish) {
+
+			[[[TKAPIRequest alloc] initAsPlacesRequestForQuery:workingQuery success:^(NSArray<TKPlace *> *places) {
+
+				[recordCache setObject:TKPlacesMakeRecord(cacheKey, places, NO,
+					TKPlacesExpirationDate(nil)) forKey:cacheKey];
+
+				finish(places, nil);
+
+			} failure:^(TKAPIError *error) {
+
+				finish(nil, error);
+
+			}] start];
+
+		} completion:^(NSArray<TKPlace *> *places, TKAPIError *error) {
+
+			if (completion)
+				completion(places, error);
+		}];
+
+		return;
 	}
 
-	NSMutableArray<NSString *> *neededQuadKeys =
-		[NSMutableArray arrayWithCapacity:query.quadKeys.count];
+	NSMutableDictionary<NSString *, NSNumber *> *neededTiles =
+		[NSMutableDictionary dictionaryWithCapacity:query.quadKeys.count];
 	NSMutableArray<TKPlace *> *cachedPlaces =
 		[NSMutableArray arrayWithCapacity:200];
+	NSMutableArray<TKPlace *> *previewPlaces =
+		[NSMutableArray arrayWithCapacity:200];
+	NSMutableData *queryTiles =
+		[NSMutableData dataWithCapacity:query.quadKeys.count * sizeof(TKQuadKey)];
 
-	TKPlacesQuery *workingQuery = [query copy];
+	for (NSString *quad in query.quadKeys) {
+		TKQuadKey tile = TKQuadKeyFromString(quad);
+		if (tile != TKQuadKeyInvalid) [queryTiles appendBytes:&tile length:sizeof(TKQuadKey)];
+	}
+
+	// Query moves the viewport, superseding its requests of tiles out of it
+	[viewport moveToTiles:queryTiles];
+
+	// Whether a newer query of the viewport has moved away from the tiles
+	BOOL (^superseded)(void) = ^BOOL{
+		return viewport && ![viewport intersectsTiles:queryTiles];
+	};
+
+	// Queries left out of a newer viewport are cancelled, overlapping ones are still served
+	TKAPIError *cancelled = [TKAPIError errorWithDomain:NSURLErrorDomain
+		code:NSURLErrorCancelled userInfo:nil];
 
 	for (NSString *quad in query.quadKeys) {
 
-		workingQuery.quadKeys = @[ quad ];
-		NSUInteger queryHash = workingQuery.hash;
+		// Malformed quad keys are dropped, they can be neither requested nor cached
+		TKQuadKey tile = TKQuadKeyFromString(quad);
+		if (tile == TKQuadKeyInvalid) continue;
+
+		NSString *cacheKey = TKPlacesCacheKey(querySignature, tile);
 
-		NSArray<TKPlace *> *cached = [placesCache objectForKey:@(queryHash)];
+		TKPlacesTileRecord *cached = [recordCache objectForKey:cacheKey];
 
-		if (cached)
-			[cachedPlaces addObjectsFromArray:cached];
-		else
-			[neededQuadKeys addObject:quad];
+		if (cached && !cached.expired) {
+			[cachedPlaces addObjectsFromArray:cached.places];
+			continue;
+		}
+
+		// Complete ancestor tile answers the query exactly,
+		// an incomplete one only provides a preview
+
+		TKPlacesTileRecord *ancestor = TKPlacesAncestorRecord(querySignature, tile,
+		  ^TKPlacesTileRecord *(NSString *ancestorKey) {
+			TKPlacesTileRecord *record = [recordCache objectForKey:ancestorKey];
+			return (record.expired) ? nil : record;
+		});
+
+		NSArray<TKPlace *> *derived = TKPlacesInTile(ancestor.places, tile);
+
+		if (ancestor.complete) {
+			[recordCache setObject:TKPlacesMakeRecord(cacheKey, derived, YES,
+				ancestor.expirationDate) forKey:cacheKey];
+			[cachedPlaces addObjectsFromArray:derived];
+			continue;
+		}
+
+		[previewPlaces addObjectsFromArray:derived];
+		neededTiles[cacheKey] = @(tile);
 	}
 
-	if (query.quadKeys.count && !neededQuadKeys.count) {
+	if (!neededTiles.count) {
 		if (completion)
-		{
-			[cachedPlaces sortUsingComparator:^NSComparisonResult(TKPlace *lhs, TKPlace *rhs) {
-				return [rhs.rating ?: @0 compare:lhs.rating ?: @0];
-			}];
-			completion(cachedPlaces, nil);
-		}
+			completion(TKPlacesSortedByRating(cachedPlaces), nil);
 		return;
 	}
 
-	workingQuery.quadKeys = neededQuadKeys;
+	// Preview is delivered at most once, as soon as there is anything to show
 
-	[[[TKAPIRequest alloc] initAsPlacesRequestForQuery:workingQuery success:^(NSArray<TKPlace *> *places) {
+	__block BOOL previewed = NO;
 
-		if (neededQuadKeys.count)
-		{
-			[cachedPlaces addObjectsFromArray:places];
+	if (preview && previewPlaces.count) {
+		previewed = YES;
+		preview(TKPlacesSortedByRating([cachedPlaces arrayByAddingObjectsFromArray:previewPlaces]));
+	}
 
-			NSMutableDictionary<NSString *, NSMutableArray<TKPlace *> *>
-				*sorted = [NSMutableDictionary dictionaryWithCapacity:neededQuadKeys.count];
+	// Look up the persistent tile cache before asking the API
 
-			for (NSString *quad in neededQuadKeys)
-				sorted[quad] = [NSMutableArray arrayWithCapacity:64];
+	TKPlacesTileCache *tileCache = [TKPlacesTileCache sharedCache];
 
-			for (TKPlace *p in places)
-				for (NSString *quad in neededQuadKeys)
-					if ([p.quadKey hasPrefix:quad])
-					{
-						[sorted[quad] addObject:p];
-						break;
-					}
+	NSMutableSet<NSString *> *lookedUpKeys = [NSMutableSet setWithArray:neededTiles.allKeys];
+
+	// Collect keys of all ancestors the lookup would check
+	[neededTiles enumerateKeysAndObjectsUsingBlock:^(NSString *__unused cacheKey, NSNumber *tile, BOOL *__unused stop) {
+		TKPlacesAncestorRecord(querySignature, tile.unsignedLongLongValue, ^TKPlacesTileRecord *(NSString *ancestorKey) {
+			[lookedUpKeys addObject:ancestorKey];
+			return nil;
+		});
+	}];
+
+	[tileCache fetchRecordsForKeys:lookedUpKeys.allObjects completion:
+	  ^(NSDictionary<NSString *, TKPlacesTileRecord *> *records) {
+
+		// Viewport has moved away meanwhile, the newer query asks for the tiles it needs
+		if (superseded()) {
+			if (completion)
+				[[TKAPIRequest responseQueue] addOperationWithBlock:^{
+					completion(nil, cancelled);
+				}];
+			return;
+		}
+
+		NSMutableDictionary<NSString *, NSNumber *> *fetchedTiles = [NSMutableDictionary dictionary];
+		NSMutableDictionary<NSString *, TKPlacesTileRecord *> *revalidatedTiles = [NSMutableDictionary dictionary];
+		NSMutableDictionary<NSString *, NSArray<TKPlace *> *> *stalePlaces = [NSMutableDictionary dictionary];
+
+		[neededTiles enumerateKeysAndObjectsUsingBlock:^(NSString *cacheKey, NSNumber *tileNumber, BOOL *__unused stop) {
+
+			TKQuadKey tile = tileNumber.unsignedLongLongValue;
+			TKPlacesTileRecord *record = records[cacheKey];
+
+			if (record && !record.expired) {
+				[recordCache setObject:record forKey:cacheKey];
+				[cachedPlaces addObjectsFromArray:record.places];
+				return;
+			}
+
+			TKPlacesTileRecord *ancestor = TKPlacesAncestorRecord(querySignature, tile,
+			  ^TKPlacesTileRecord *(NSString *ancestorKey) {
+				return records[ancestorKey];
+			});
+
+			NSArray<TKPlace *> *derived = TKPlacesInTile(ancestor.places, tile);
+
+			if (ancestor.complete && !ancestor.expired) {
+				[recordCache setObject:TKPlacesMakeRecord(cacheKey, derived, YES,
+					ancestor.expirationDate) forKey:cacheKey];
+				[cachedPlaces addObjectsFromArray:derived];
+				return;
+			}
+
+			// Stale data serve as a preview and a fallback when the API cannot be reached
+			if (record) stalePlaces[cacheKey] = record.places;
+			else if (ancestor.complete) stalePlaces[cacheKey] = derived;
 
-			for (NSString *quad in sorted.allKeys)
-			{
-				workingQuery.quadKeys = @[ quad ];
-				NSUInteger hash = workingQuery.hash;
-				NSMutableArray<TKPlace *> *quadPlaces = sorted[quad];
-				[placesCache setObject:quadPlaces forKey:@(hash)];
+			if (record.ETag) revalidatedTiles[cacheKey] = record;
+			else fetchedTiles[cacheKey] = tileNumber;
+		}];
+
+		if (preview && !previewed && stalePlaces.count && !superseded()) {
+			NSMutableArray<TKPlace *> *places = [cachedPlaces mutableCopy];
+			for (NSArray<TKPlace *> *stale in stalePlaces.allValues)
+				[places addObjectsFromArray:stale];
+			preview(TKPlacesSortedByRating(places));
+		}
+
+		dispatch_group_t group = dispatch_group_create();
+		__block TKAPIError *failure = nil;
+
+		void (^fallback)(NSString *, TKAPIError *) = ^(NSString *cacheKey, TKAPIError *error) {
+			@synchronized (cachedPlaces) {
+				NSArray<TKPlace *> *stale = stalePlaces[cacheKey];
+				if (stale) [cachedPlaces addObjectsFromArray:stale];
+				else failure = error;
 			}
+		};
+
+		// Tiles already requested by another caller are awaited instead of fetched again
+
+		TKAPIRequestCoalescer *coalescer = [TKAPIRequestCoalescer sharedCoalescer];
 
-			places = [cachedPlaces sortedArrayUsingComparator:^NSComparisonResult(TKPlace *lhs, TKPlace *rhs) {
-				return [rhs.rating ?: @0 compare:lhs.rating ?: @0];
+		for (NSString *cacheKey in [fetchedTiles.allKeys arrayByAddingObjectsFromArray:revalidatedTiles.allKeys])
+		{
+			dispatch_group_enter(group);
+
+			BOOL joined = [coalescer joinFlightWithKey:TKPlacesFlightKey(cacheKey)
+			  completion:^(NSArray<TKPlace *> *places, TKAPIError *error) {
+
+				if (places) {
+					@synchronized (cachedPlaces) {
+						[cachedPlaces addObjectsFromArray:places];
+					}
+				}
+				else fallback(cacheKey, error);
+
+				dispatch_group_leave(group);
 			}];
+
+			if (joined) {
+				[fetchedTiles removeObjectForKey:cacheKey];
+				[revalidatedTiles removeObjectForKey:cacheKey];
+			}
+			else dispatch_group_leave(group);
 		}
-		else {
-			NSUInteger queryHash = workingQuery.hash;
-			[placesCache setObject:places forKey:@(queryHash)];
 
+		// Fetch tiles without usable records in a single request
+
+		if (fetchedTiles.count)
+		{
+			NSArray<NSString *> *cacheKeys = fetchedTiles.allKeys;
+			NSMutableArray<NSString *> *quadKeys = [NSMutableArray arrayWithCapacity:cacheKeys.count];
+
+			for (NSString *cacheKey in cacheKeys)
+				[quadKeys addObject:TKQuadKeyToString(fetchedTiles[cacheKey].unsignedLongLongValue)];
+
+			TKPlacesQuery *tilesQuery = [workingQuery copy];
+			tilesQuery.quadKeys = quadKeys;
+
+			NSMutableData *requestTiles = [NSMutableData dataWithCapacity:cacheKeys.count * sizeof(TKQuadKey)];
+
+			for (NSString *cacheKey in cacheKeys) {
+				TKQuadKey tile = fetchedTiles[cacheKey].unsignedLongLongValue;
+				[requestTiles appendBytes:&tile length:sizeof(TKQuadKey)];
+			}
+
+			dispatch_group_enter(group);
+
+			__block __weak TKAPIRequest *weakRequest = nil;
+
+			TKAPIRequest *request = [[TKAPIRequest alloc] initAsPlacesRequestForQuery:tilesQuery responseSuccess:
+			  ^(TKAPIResponse *response, NSArray<TKPlace *> *places, NSArray<NSData *> *items) {
+
+				[viewport removeRequest:weakRequest];
+
+				NSUInteger neededCount = cacheKeys.count;
+				TKQuadKey tiles[neededCount];
+
+				for (NSUInteger i = 0; i < neededCount; i++)
+					tiles[i] = fetchedTiles[cacheKeys[i]].unsignedLongLongValue;
+
+				NSMutableArray<NSMutableArray<TKPlace *> *>
+					*sorted = [NSMutableArray arrayWithCapacity:neededCount];
+				NSMutableArray<NSMutableArray<NSData *> *>
+					*sortedItems = [NSMutableArray arrayWithCapacity:neededCount];
+
+				for (NSUInteger i = 0; i < neededCount; i++) {
+					[sorted addObject:[NSMutableArray arrayWithCapacity:64]];
+					[sortedItems addObject:[NSMutableArray arrayWithCapacity:64]];
+				}
+
+				[places enumerateObjectsUsingBlock:^(TKPlace *p, NSUInteger idx, BOOL *__unused stop) {
+
+					TKQuadKey placeTile = p.packedQuadKey;
+
+					for (NSUInteger i = 0; i < neededCount; i++)
+						if (TKQuadKeyHasPrefix(placeTile, tiles[i]))
+						{
+							[sorted[i] addObject:p];
+							[sortedItems[i] addObject:items[idx]];
+							break;
+						}
+				}];
+
+				// Response validator only describes the tile when asked for a single one
+				NSString *ETag = (neededCount == 1) ? [response valueForHeaderField:@"ETag"] : nil;
+				NSTimeInterval maxAge = TKPlacesMaxAge(response);
+				NSDate *expirationDate = TKPlacesExpirationDate(response);
+				BOOL complete = TKPlacesResponseIsComplete(tilesQuery, places.count);
+
+				for (NSUInteger i = 0; i < neededCount; i++) {
+					[recordCache setObject:TKPlacesMakeRecord(cacheKeys[i], sorted[i],
+						complete, expirationDate) forKey:cacheKeys[i]];
+					[tileCache storeItems:sortedItems[i] forKey:cacheKeys[i] ETag:ETag maxAge:maxAge complete:complete];
+					[coalescer finishFlightWithKey:TKPlacesFlightKey(cacheKeys[i]) result:sorted[i] error:nil];
+				}
+
+				@synchronized (cachedPlaces) {
+					[cachedPlaces addObjectsFromArray:places];
+				}
+
+				dispatch_group_leave(group);
+
+			} failure:^(TKAPIError *error) {
+
+				[viewport removeRequest:weakRequest];
+
+				for (NSString *cacheKey in cacheKeys) {
+					[coalescer finishFlightWithKey:TKPlacesFlightKey(cacheKey) result:nil error:error];
+					fallback(cacheKey, error);
+				}
+
+				dispatch_group_leave(group);
+			}];
+
+			NSMutableArray<NSString *> *flightKeys = [NSMutableArray arrayWithCapacity:cacheKeys.count];
+			for (NSString *cacheKey in cacheKeys)
+				[flightKeys addObject:TKPlacesFlightKey(cacheKey)];
+
+			weakRequest = request;
+			[viewport addRequest:request tiles:requestTiles flightKeys:flightKeys];
+			[request start];
 		}
 
-		if (completion)
-			completion(places, nil);
+		// Revalidate expired tiles holding a validator one by one
 
-	} failure:^(TKAPIError *error) {
+		[revalidatedTiles enumerateKeysAndObjectsUsingBlock:
+		  ^(NSString *cacheKey, TKPlacesTileRecord *record, BOOL *__unused stop) {
+
+			TKQuadKey tile = neededTiles[cacheKey].unsignedLongLongValue;
+
+			TKPlacesQuery *tileQuery = [workingQuery copy];
+			tileQuery.quadKeys = @[ TKQuadKeyToString(tile) ];
+
+			__block __weak TKAPIRequest *weakRequest = nil;
+
+			TKAPIRequest *request = [[TKAPIRequest alloc] initAsPlacesRequestForQuery:tileQuery responseSuccess:
+			  ^(TKAPIResponse *response, NSArray<TKPlace *> *places, NSArray<NSData *> *items) {
+
+				[viewport removeRequest:weakRequest];
+
+				BOOL complete = TKPlacesResponseIsComplete(tileQuery, places.count);
+
+				[recordCache setObject:TKPlacesMakeRecord(cacheKey, places, complete,
+					TKPlacesExpirationDate(response)) forKey:cacheKey];
+				[tileCache storeItems:items forKey:cacheKey ETag:[response valueForHeaderField:@"ETag"]
+					maxAge:TKPlacesMaxAge(response) complete:complete];
+				[coalescer finishFlightWithKey:TKPlacesFlightKey(cacheKey) result:places error:nil];
+
+				@synchronized (cachedPlaces) {
+					[cachedPlaces addObjectsFromArray:places];
+				}
+
+				dispatch_group_leave(group);
 
+			} failure:^(TKAPIError *error) {
+
+				[viewport removeRequest:weakRequest];
+
+				if (error.code == 304 && [error.domain isEqualToString:TKAPIErrorDomain]) {
+					[recordCache setObject:TKPlacesMakeRecord(cacheKey, record.places,
+						record.complete, TKPlacesExpirationDate(nil)) forKey:cacheKey];
+					[tileCache refreshRecordForKey:cacheKey maxAge:0];
+					[coalescer finishFlightWithKey:TKPlacesFlightKey(cacheKey) result:record.places error:nil];
+				}
+				else [coalescer finishFlightWithKey:TKPlacesFlightKey(cacheKey) result:nil error:error];
+
+				fallback(cacheKey, error);
+
+				dispatch_group_leave(group);
+			}];
+
+			[request setValue:record.ETag forHTTPHeaderField:@"If-None-Match"];
+
+			dispatch_group_enter(group);
+
+			weakRequest = request;
+			[viewport addRequest:request tiles:[NSData dataWithBytes:&tile length:sizeof(TKQuadKey)]
+				flightKeys:@[ TKPlacesFlightKey(cacheKey) ]];
+			[request start];
+		}];
+
+		TKPlacesNotifyGroup(group, ^{
+
+			if (!completion) return;
+
+			// Late results of viewports moved away from are not delivered
+			if (superseded()) completion(nil, cancelled);
+			else if (failure) completion(nil, failure);
+			else completion(TKPlacesSortedByRating(cachedPlaces), nil);
+		});
+	}];
+}
+
+- (void)mapPlacesForQuery:(TKPlacesQuery *)query completion:(void (^)(NSArray<TKPlace *> *, NSError *))completion
+{
+	NSCache<NSString *, TKPlacesStore *> *storeCache = [self.class placesStoreCache];
+
+	TKCanonicalEncoder *encoder = [TKCanonicalEncoder new];
+	[encoder encodeString:[TKAPI sharedAPI].languageID forField:1];
+	[encoder encodeData:query.canonicalData forField:2];
+
+	NSString *cacheKey = encoder.digest;
+
+	TKPlacesStore *cached = [storeCache objectForKey:cacheKey];
+
+	if (cached) {
 		if (completion)
-			completion(nil, error);
+			completion(cached.places, nil);
+		return;
+	}
 
-	}] start];
+	query = [query copy];
+
+	[[TKAPIRequestCoalescer sharedCoalescer] performFlightWithKey:[@"mapPlaces|" stringByAppendingString:cacheKey]
+	  start:^(TKAPIFlightCompletion finish) {
+
+		[[[TKAPIRequest alloc] initAsPlacesRequestForQuery:query
+		  storeSuccess:^(TKAPIResponse *__unused response, TKPlacesStore *store) {
+
+			[storeCache setObject:store forKey:cacheKey];
+
+			finish(store, nil);
+
+		} failure:^(TKAPIError *error) {
+
+			finish(nil, error);
+
+		}] start];
+
+	} completion:^(TKPlacesStore *store, TKAPIError *error) {
+
+		if (completion)
+			completion(store.places, error);
+	}];
 }
 
 - (void)detailedPlacesWithIDs:(NSArray<NSString *> *)placeIDs completion:(void (^)(NSArray<TKDetailedPlace *> *, NSError *))completion
 {
-	if (placeIDs.count > 32)
-		placeIDs = [placeIDs subarrayWithRange:NSMakeRange(0, 32)];
-
 	NSCache<NSString *, TKDetailedPlace *> *placeCache = [self.class detailedPlaceCache];
 
-	NSMutableArray<TKDetailedPlace *> *ret = [NSMutableArray arrayWithCapacity:placeIDs.count];
-	NSMutableArray<NSString *> *requestedIDs = [placeIDs mutableCopy];
+	NSMutableDictionary<NSString *, TKDetailedPlace *> *places =
+		[NSMutableDictionary dictionaryWithCapacity:placeIDs.count];
+	NSMutableOrderedSet<NSString *> *requestedIDs =
+		[NSMutableOrderedSet orderedSetWithCapacity:placeIDs.count];
 
 	TKDetailedPlace *place = nil;
 	for (NSString *placeID in placeIDs)
 		if ((place = [placeCache objectForKey:placeID]))
-		{
-			[ret addObject:place];
-			[requestedIDs removeObject:placeID];
-		}
+			places[placeID] = place;
+		else [requestedIDs addObject:placeID];
 
-	if (!requestedIDs.count) {
-		if (completion)
-			completion(ret, nil);
-		return;
-	}
+	// Missing places are collected by the batcher, sharing batch requests with other lookups
 
-	[[[TKAPIRequest alloc] initAsPlacesRequestForIDs:requestedIDs success:^(NSArray<TKDetailedPlace *> *places) {
+	dispatch_group_t group = dispatch_group_create();
+	__block TKAPIError *failure = nil;
 
-		for (TKDetailedPlace *p in places)
-			[placeCache setObject:p forKey:p.ID];
+	for (NSString *placeID in requestedIDs)
+	{
+		dispatch_group_enter(group);
 
-		[ret addObjectsFromArray:places];
+		[self detailedPlaceFlightForID:placeID completion:^(TKDetailedPlace *p, TKAPIError *error) {
 
-		if (completion)
-			completion(ret, nil);
+			// Places missing from the response are skipped, only request failures fail the call
+			@synchronized (places) {
+				if (p) places[placeID] = p;
+				else if (error) failure = error;
+			}
 
-	} failure:^(TKAPIError *error) {
+			dispatch_group_leave(group);
+		}];
+	}
 
-		if (completion)
-			completion(nil, error);
+	TKPlacesNotifyGroup(group, ^{
 
-	}] start];
+		if (!completion) return;
+
+		if (failure) {
+			completion(nil, failure);
+			return;
+		}
+
+		NSMutableArray<TKDetailedPlace *> *ret = [NSMutableArray arrayWithCapacity:placeIDs.count];
+
+		for (NSString *placeID in placeIDs) {
+			TKDetailedPlace *p = places[placeID];
+			if (p) [ret addObject:p];
+		}
+
+		completion(ret, nil);
+	});
 }
 
 - (void)detailedPlaceWithID:(NSString *)placeID completion:(void (^)(TKDetailedPlace *, NSError *))completion
@@ -224,19 +1004,26 @@
 		return;
 	}
 
-	[[[TKAPIRequest alloc] initAsPlaceRequestForItemWithID:placeID success:^(TKDetailedPlace *place) {
+	[self detailedPlaceFlightForID:placeID completion:^(TKDetailedPlace *place, TKAPIError *error) {
 
-		[placeCache setObject:place forKey:placeID];
+		// Place left out of the batch response does not exist
+		if (!place && !error)
+			error = [TKAPIError errorWithCode:404
+				userInfo:@{ NSLocalizedDescriptionKey: @"Place not found" }];
 
 		if (completion)
-			completion(place, nil);
-
-	} failure:^(TKAPIError *error) {
+			completion(place, (place) ? nil : error);
+	}];
+}
 
-		if (completion)
-			completion(nil, error);
+- (void)detailedPlaceFlightForID:(NSString *)placeID completion:(TKAPIFlightCompletion)completion
+{
+	TKDetailedPlacesBatcher *batcher = _detailsBatcher;
 
-	}] start];
+	[[TKAPIRequestCoalescer sharedCoalescer] performFlightWithKey:TKPlaceFlightKey(placeID)
+	  start:^(TKAPIFlightCompletion finish) {
+		[batcher fetchPlaceWithID:placeID completion:finish];
+	} completion:completion];
 }
 
 - (void)mediaForPlaceWithID:(NSString *)placeID completion:(void (^)(NSArray<TKMedium *> *, NSError *))completion
@@ -257,19 +1044,26 @@
 		return;
 	}
 
-	[[[TKAPIRequest alloc] initAsMediaRequestForPlaceWithID:placeID success:^(NSArray<TKMedium *> *media) {
+	[[TKAPIRequestCoalescer sharedCoalescer] performFlightWithKey:[@"media|" stringByAppendingString:placeID]
+	  start:^(TKAPIFlightCompletion finish) {
 
-		[mediaCache setObject:media forKey:placeID];
+		[[[TKAPIRequest alloc] initAsMediaRequestForPlaceWithID:placeID success:^(NSArray<TKMedium *> *media) {
 
-		if (completion)
-			completion(media, nil);
+			[mediaCache setObject:media forKey:placeID];
 
-	} failure:^(TKAPIError *error){
+			finish(media, nil);
 
-		if (completion)
-			completion(nil, error);
+		} failure:^(TKAPIError *error){
 
-	}] start];
+			finish(nil, error);
+
+		}] start];
+
+	} completion:^(NSArray<TKMedium *> *media, TKAPIError *error) {
+
+		if (completion)
+			completion(media, error);
+	}];
 }
 
 - (void)placeCollectionsForQuery:(TKCollectionsQuery *)query
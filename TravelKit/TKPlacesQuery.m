@@ -6,7 +6,8 @@
 //  Copyright © 2017 Tripomatic. All rights reserved.
 //
 
-#import <TravelKit/TKPlacesQuery.h>
+#import "TKPlacesQuery+Private.h"
+#import "TKCanonicalEncoder+Private.h"
 
 @implementation TKPlacesQuery
 
@@ -22,6 +23,35 @@
 	return self;
 }
 
+- (NSData *)canonicalData
+{
+	TKCanonicalEncoder *encoder = [TKCanonicalEncoder new];
+
+	[encoder encodeString:_searchTerm forField:1];
+	[encoder encodeLocation:_preferredLocation forField:2];
+	[encoder encodeUnsignedInteger:_levels forField:3];
+	[encoder encodeStringSet:_quadKeys forField:4];
+	[encoder encodeRegion:_bounds forField:5];
+	[encoder encodeNumber:_mapSpread forField:6];
+	[encoder encodeUnsignedInteger:_categories forField:7];
+	if (_categories) [encoder encodeUnsignedInteger:_categoriesMatching forField:8];
+	[encoder encodeStringSet:_tags forField:9];
+	if (_tags.count) [encoder encodeUnsignedInteger:_tagsMatching forField:10];
+	[encoder encodeStringSet:_parentIDs forField:11];
+	if (_parentIDs.count) [encoder encodeUnsignedInteger:_parentIDsMatching forField:12];
+	[encoder encodeNumber:_minimumRating forField:13];
+	[encoder encodeNumber:_maximumRating forField:14];
+	[encoder encodeNumber:_limit forField:15];
+	[encoder encodeNumber:_offset forField:16];
+
+	return encoder.data;
+}
+
+- (NSString *)digest
+{
+	return [TKCanonicalEncoder digestForData:self.canonicalData];
+}
+
 -(NSUInteger)hash
 {
 	NSUInteger result = 1;
@@ -63,6 +93,7 @@
 
 	query.levels = _levels;
 	query.searchTerm = [_searchTerm copy];
+	query.preferredLocation = _preferredLocation;
 	query.categories = _categories;
 	query.categoriesMatching = _categoriesMatching;
 	query.tags = [_tags copy];
@@ -0,0 +1,99 @@
+//
+//  TKPlacesStore+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <CoreLocation/CoreLocation.h>
+
+#import <TravelKit/TKPlace.h>
+#import <TravelKit/TKMapRegion.h>
+
+#import "TKMapWorker+Private.h"
+#import "TKJSONStreamParser+Private.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Boolean attributes of a stored place.
+typedef NS_OPTIONS(UInt8, TKPlacesStoreFlags) {
+	TKPlacesStoreFlagNone                  = 0,
+	TKPlacesStoreFlagThumbnail             = 1 << 0,
+	TKPlacesStoreFlagWikipediaDescription  = 1 << 1,
+	TKPlacesStoreFlagShapeGeometry         = 1 << 2,
+	TKPlacesStoreFlagBoundingBox           = 1 << 3,
+};
+
+
+/**
+ Compact column store of places decoded straight from the places JSON.
+
+ Attributes needed in bulk -- coordinates, ratings, categories and quad keys -- are kept
+ in plain C arrays, remaining attributes in object columns. `TKPlace` objects are only
+ created when asked for and kept for further accesses.
+ */
+@interface TKPlacesStore : NSObject
+
+@property (nonatomic, readonly) NSUInteger count;
+
+/// Lazy array of places backed by the store. Enumerating it creates all place objects,
+/// use the column accessors where the attributes are sufficient.
+@property (nonatomic, strong, readonly) NSArray<TKPlace *> *places;
+
+// Column accessors
+
+- (NSString *)IDAtIndex:(NSUInteger)index;
+- (CLLocationCoordinate2D)coordinateAtIndex:(NSUInteger)index;
+/// Rating of the place, `NAN` when missing.
+- (float)ratingAtIndex:(NSUInteger)index;
+- (TKPlaceCategory)categoriesAtIndex:(NSUInteger)index;
+- (TKQuadKey)quadKeyAtIndex:(NSUInteger)index;
+- (TKPlaceLevel)levelAtIndex:(NSUInteger)index;
+- (TKPlacesStoreFlags)flagsAtIndex:(NSUInteger)index;
+
+- (NSString *)nameAtIndex:(NSUInteger)index;
+- (nullable NSString *)suffixAtIndex:(NSUInteger)index;
+- (nullable NSString *)perexAtIndex:(NSUInteger)index;
+- (nullable NSString *)thumbnailAtIndex:(NSUInteger)index;
+- (nullable NSString *)kindAtIndex:(NSUInteger)index;
+- (nullable NSString *)markerAtIndex:(NSUInteger)index;
+- (nullable NSArray<NSString *> *)parentsAtIndex:(NSUInteger)index;
+- (nullable TKMapRegion *)boundingBoxAtIndex:(NSUInteger)index;
+
+/// Place object of the given index, created on first access.
+- (TKPlace *)placeAtIndex:(NSUInteger)index;
+
+@end
+
+
+/**
+ Schema-driven decoder filling a `TKPlacesStore` from parser events of a places array.
+
+ Expects events of the array elements only, ie. as forwarded by `TKJSONStreamCollector`.
+ Values not described by the schema are skipped without being built.
+ */
+@interface TKPlacesStoreDecoder : NSObject <TKJSONStreamParserDelegate>
+
+/// Store being filled
+@property (nonatomic, strong, readonly) TKPlacesStore *store;
+
+@end
+
+
+/// Array of places backed by a store, `TKPlace` objects are created on access.
+@interface TKPlacesStoreArray : NSArray<TKPlace *>
+
+@property (nonatomic, strong, readonly) TKPlacesStore *store;
+
+/// Initializer. `indexes` holds `NSUInteger` store indexes of the elements,
+/// `nil` makes the array cover the whole store.
+- (instancetype)initWithStore:(TKPlacesStore *)store indexes:(nullable NSData *)indexes;
+
+/// Index of the element in the backing store
+- (NSUInteger)storeIndexAtIndex:(NSUInteger)index;
+
+@end
+
+NS_ASSUME_NONNULL_END
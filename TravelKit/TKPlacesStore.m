@@ -0,0 +1,611 @@
+//
+//  TKPlacesStore.m
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import "TKPlacesStore+Private.h"
+#import "TKPlace+Private.h"
+
+// Schema key describing elements of an array
+#define TK_SCHEMA_ELEMENTS   @"[]"
+
+// Detail level of quad keys computed for places missing one
+#define TK_PLACES_STORE_QUADKEY_LEVEL   18
+
+typedef NS_ENUM(NSUInteger, TKPlacesColumn) {
+	TKPlacesColumnID = 1,
+	TKPlacesColumnName,
+	TKPlacesColumnSuffix,
+	TKPlacesColumnPerex,
+	TKPlacesColumnLevel,
+	TKPlacesColumnThumbnail,
+	TKPlacesColumnQuadKey,
+	TKPlacesColumnLatitude,
+	TKPlacesColumnLongitude,
+	TKPlacesColumnBoxSouth,
+	TKPlacesColumnBoxWest,
+	TKPlacesColumnBoxNorth,
+	TKPlacesColumnBoxEast,
+	TKPlacesColumnRating,
+	TKPlacesColumnKind,
+	TKPlacesColumnMarker,
+	TKPlacesColumnCategory,
+	TKPlacesColumnParent,
+	TKPlacesColumnDescriptionProvider,
+	TKPlacesColumnShapeGeometry,
+};
+
+/// Schema of a place item -- nested dictionaries follow the JSON structure,
+/// leaves name the column the value is decoded into
+static NSDictionary<NSString *, id> *TKPlacesStoreSchema(void)
+{
+	static NSDictionary<NSString *, id> *schema = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		schema = @{
+			@"id": @(TKPlacesColumnID),
+			@"name": @(TKPlacesColumnName),
+			@"name_suffix": @(TKPlacesColumnSuffix),
+			@"perex": @(TKPlacesColumnPerex),
+			@"level": @(TKPlacesColumnLevel),
+			@"thumbnail_url": @(TKPlacesColumnThumbnail),
+			@"quadkey": @(TKPlacesColumnQuadKey),
+			@"location": @{
+				@"lat": @(TKPlacesColumnLatitude),
+				@"lng": @(TKPlacesColumnLongitude),
+			},
+			@"bounding_box": @{
+				@"south": @(TKPlacesColumnBoxSouth),
+				@"west": @(TKPlacesColumnBoxWest),
+				@"north": @(TKPlacesColumnBoxNorth),
+				@"east": @(TKPlacesColumnBoxEast),
+			},
+			@"rating": @(TKPlacesColumnRating),
+			@"class": @{
+				@"name": @(TKPlacesColumnKind),
+				@"slug": @(TKPlacesColumnMarker),
+			},
+			@"categories": @{
+				TK_SCHEMA_ELEMENTS: @(TKPlacesColumnCategory),
+			},
+			@"parents": @{
+				TK_SCHEMA_ELEMENTS: @{ @"id": @(TKPlacesColumnParent) },
+			},
+			@"description": @{
+				@"provider": @(TKPlacesColumnDescriptionProvider),
+			},
+			@"has_shape_geometry": @(TKPlacesColumnShapeGeometry),
+		};
+	});
+
+	return schema;
+}
+
+/// Reversed dictionary of the given one
+static NSDictionary *TKPlacesStoreReversed(NSDictionary *dictionary)
+{
+	NSMutableDictionary *reversed = [NSMutableDictionary dictionaryWithCapacity:dictionary.count];
+
+	[dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id obj, BOOL *__unused stop) {
+		reversed[obj] = key;
+	}];
+
+	return reversed;
+}
+
+static inline id TKPlacesStoreObject(id _Nullable object)
+{
+	return object ?: [NSNull null];
+}
+
+static inline id TKPlacesStoreNullable(id object)
+{
+	return (object == [NSNull null]) ? nil : object;
+}
+
+
+#pragma mark - Row -
+
+
+/// Attributes of a single place being decoded
+@interface TKPlacesStoreRow : NSObject
+{
+	@package
+	NSString *_ID, *_name, *_suffix, *_perex, *_thumbnail, *_kind, *_marker, *_quadKey;
+	NSMutableArray<NSString *> *_parents;
+	double _latitude, _longitude;
+	double _box[4];
+	float _rating;
+	TKPlaceCategory _categories;
+	TKPlaceLevel _level;
+	TKPlacesStoreFlags _flags;
+}
+
+- (void)reset;
+
+@end
+
+@implementation TKPlacesStoreRow
+
+- (void)reset
+{
+	_ID = _name = _suffix = _perex = _thumbnail = _kind = _marker = _quadKey = nil;
+	_parents = nil;
+	_latitude = _longitude = NAN;
+	_box[0] = _box[1] = _box[2] = _box[3] = NAN;
+	_rating = NAN;
+	_categories = TKPlaceCategoryNone;
+	_level = TKPlaceLevelUnknown;
+	_flags = TKPlacesStoreFlagNone;
+}
+
+@end
+
+
+#pragma mark - Store -
+
+
+@interface TKPlacesStore ()
+
+- (void)appendRow:(TKPlacesStoreRow *)row;
+
+@end
+
+@implementation TKPlacesStore
+{
+	// Bulk columns
+	NSMutableData *_coordinates;
+	NSMutableData *_ratings;
+	NSMutableData *_categories;
+	NSMutableData *_quadKeys;
+	NSMutableData *_levels;
+	NSMutableData *_flags;
+	NSMutableData *_boxes;
+
+	// Object columns, missing values are NSNull
+	NSMutableArray<NSString *> *_IDs;
+	NSMutableArray<NSString *> *_names;
+	NSMutableArray<id> *_suffixes;
+	NSMutableArray<id> *_perexes;
+	NSMutableArray<id> *_thumbnails;
+	NSMutableArray<id> *_kinds;
+	NSMutableArray<id> *_markers;
+	NSMutableArray<id> *_parents;
+
+	// Place objects created so far
+	NSMutableArray<id> *_placeObjects;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_coordinates = [NSMutableData dataWithCapacity:64 * sizeof(CLLocationCoordinate2D)];
+		_ratings = [NSMutableData dataWithCapacity:64 * sizeof(float)];
+		_categories = [NSMutableData dataWithCapacity:64 * sizeof(TKPlaceCategory)];
+		_quadKeys = [NSMutableData dataWithCapacity:64 * sizeof(TKQuadKey)];
+		_levels = [NSMutableData dataWithCapacity:64 * sizeof(TKPlaceLevel)];
+		_flags = [NSMutableData dataWithCapacity:64 * sizeof(TKPlacesStoreFlags)];
+		_boxes = [NSMutableData data];
+
+		_IDs = [NSMutableArray arrayWithCapacity:64];
+		_names = [NSMutableArray arrayWithCapacity:64];
+		_suffixes = [NSMutableArray arrayWithCapacity:64];
+		_perexes = [NSMutableArray arrayWithCapacity:64];
+		_thumbnails = [NSMutableArray arrayWithCapacity:64];
+		_kinds = [NSMutableArray arrayWithCapacity:64];
+		_markers = [NSMutableArray arrayWithCapacity:64];
+		_parents = [NSMutableArray arrayWithCapacity:64];
+
+		_placeObjects = [NSMutableArray arrayWithCapacity:64];
+	}
+
+	return self;
+}
+
+- (void)appendRow:(TKPlacesStoreRow *)row
+{
+	CLLocationCoordinate2D coordinate = CLLocationCoordinate2DMake(row->_latitude, row->_longitude);
+
+	// Quad key is computed from the coordinate when missing or malformed
+	TKQuadKey quadKey = TKQuadKeyFromString(row->_quadKey);
+	if (quadKey == TKQuadKeyInvalid) quadKey = TKQuadKeyMake(TKQuadKeyBitsForCoordinate(
+		coordinate, TK_PLACES_STORE_QUADKEY_LEVEL), TK_PLACES_STORE_QUADKEY_LEVEL);
+
+	TKPlacesStoreFlags flags = row->_flags;
+	if (row->_thumbnail) flags |= TKPlacesStoreFlagThumbnail;
+
+	// Bounding boxes are rare, their column is only appended to when present
+	if (!isnan(row->_box[0]) && !isnan(row->_box[1]) && !isnan(row->_box[2]) && !isnan(row->_box[3])) {
+		flags |= TKPlacesStoreFlagBoundingBox;
+		NSUInteger index = _IDs.count;
+		[_boxes appendBytes:&index length:sizeof(NSUInteger)];
+		[_boxes appendBytes:row->_box length:sizeof(row->_box)];
+	}
+
+	[_coordinates appendBytes:&coordinate length:sizeof(coordinate)];
+	[_ratings appendBytes:&row->_rating length:sizeof(float)];
+	[_categories appendBytes:&row->_categories length:sizeof(TKPlaceCategory)];
+	[_quadKeys appendBytes:&quadKey length:sizeof(TKQuadKey)];
+	[_levels appendBytes:&row->_level length:sizeof(TKPlaceLevel)];
+	[_flags appendBytes:&flags length:sizeof(TKPlacesStoreFlags)];
+
+	[_IDs addObject:row->_ID];
+	[_names addObject:row->_name];
+	[_suffixes addObject:TKPlacesStoreObject(row->_suffix)];
+	[_perexes addObject:TKPlacesStoreObject(row->_perex)];
+	[_thumbnails addObject:TKPlacesStoreObject(row->_thumbnail)];
+	[_kinds addObject:TKPlacesStoreObject(row->_kind)];
+	[_markers addObject:TKPlacesStoreObject(row->_marker)];
+	[_parents addObject:TKPlacesStoreObject([row->_parents copy])];
+}
+
+- (NSUInteger)count
+{
+	return _IDs.count;
+}
+
+- (NSArray<TKPlace *> *)places
+{
+	return [[TKPlacesStoreArray alloc] initWithStore:self indexes:nil];
+}
+
+
+#pragma mark Column accessors
+
+
+- (NSString *)IDAtIndex:(NSUInteger)index
+{
+	return _IDs[index];
+}
+
+- (CLLocationCoordinate2D)coordinateAtIndex:(NSUInteger)index
+{
+	return ((const CLLocationCoordinate2D *)_coordinates.bytes)[index];
+}
+
+- (float)ratingAtIndex:(NSUInteger)index
+{
+	return ((const float *)_ratings.bytes)[index];
+}
+
+- (TKPlaceCategory)categoriesAtIndex:(NSUInteger)index
+{
+	return ((const TKPlaceCategory *)_categories.bytes)[index];
+}
+
+- (TKQuadKey)quadKeyAtIndex:(NSUInteger)index
+{
+	return ((const TKQuadKey *)_quadKeys.bytes)[index];
+}
+
+- (TKPlaceLevel)levelAtIndex:(NSUInteger)index
+{
+	return ((const TKPlaceLevel *)_levels.bytes)[index];
+}
+
+- (TKPlacesStoreFlags)flagsAtIndex:(NSUInteger)index
+{
+	return ((const TKPlacesStoreFlags *)_flags.bytes)[index];
+}
+
+- (NSString *)nameAtIndex:(NSUInteger)index
+{
+	return _names[index];
+}
+
+- (NSString *)suffixAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_suffixes[index]);
+}
+
+- (NSString *)perexAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_perexes[index]);
+}
+
+- (NSString *)thumbnailAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_thumbnails[index]);
+}
+
+- (NSString *)kindAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_kinds[index]);
+}
+
+- (NSString *)markerAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_markers[index]);
+}
+
+- (NSArray<NSString *> *)parentsAtIndex:(NSUInteger)index
+{
+	return TKPlacesStoreNullable(_parents[index]);
+}
+
+- (TKMapRegion *)boundingBoxAtIndex:(NSUInteger)index
+{
+	if (!([self flagsAtIndex:index] & TKPlacesStoreFlagBoundingBox))
+		return nil;
+
+	// Box entries are sorted by the place index
+	const size_t entrySize = sizeof(NSUInteger) + 4 * sizeof(double);
+	const uint8_t *bytes = _boxes.bytes;
+	NSUInteger low = 0, high = _boxes.length / entrySize;
+
+	while (low < high)
+	{
+		NSUInteger mid = (low + high) / 2;
+		NSUInteger entryIndex;
+		memcpy(&entryIndex, bytes + mid * entrySize, sizeof(NSUInteger));
+
+		if (entryIndex < index) low = mid + 1;
+		else if (entryIndex > index) high = mid;
+		else {
+			double box[4];
+			memcpy(box, bytes + mid * entrySize + sizeof(NSUInteger), sizeof(box));
+			CLLocation *southWest = [[CLLocation alloc] initWithLatitude:box[0] longitude:box[1]];
+			CLLocation *northEast = [[CLLocation alloc] initWithLatitude:box[2] longitude:box[3]];
+			return [[TKMapRegion alloc] initWithSouthWestPoint:southWest northEastPoint:northEast];
+		}
+	}
+
+	return nil;
+}
+
+- (TKPlace *)placeAtIndex:(NSUInteger)index
+{
+	@synchronized (self) {
+
+		while (_placeObjects.count <= index)
+			[_placeObjects addObject:[NSNull null]];
+
+		TKPlace *place = _placeObjects[index];
+
+		if ([place isKindOfClass:[TKPlace class]])
+			return place;
+
+		place = [[TKPlace alloc] initFromStore:self index:index];
+		_placeObjects[index] = place;
+
+		return place;
+	}
+}
+
+@end
+
+
+#pragma mark - Store decoder -
+
+
+@implementation TKPlacesStoreDecoder
+{
+	TKPlacesStoreRow *_row;
+	BOOL _rowOpen;
+
+	// Schema nodes of the open containers, NSNull for skipped ones
+	NSMutableArray<id> *_nodes;
+	NSMutableData *_containerKinds;
+	id _keyNode;
+
+	NSDictionary<NSString *, NSNumber *> *_categoriesBySlug;
+	NSDictionary<NSString *, NSNumber *> *_levelsByString;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_store = [TKPlacesStore new];
+		_row = [TKPlacesStoreRow new];
+		_nodes = [NSMutableArray arrayWithCapacity:8];
+		_containerKinds = [NSMutableData dataWithCapacity:8];
+		_categoriesBySlug = TKPlacesStoreReversed([TKPlace categorySlugs]);
+		_levelsByString = TKPlacesStoreReversed([TKPlace levelStrings]);
+	}
+
+	return self;
+}
+
+
+#pragma mark Schema navigation
+
+
+/// Schema node of a value found in the current container
+- (id)takeTargetNode
+{
+	if (!_nodes.count) return nil;
+
+	NSDictionary *parent = _nodes.lastObject;
+
+	if (![parent isKindOfClass:[NSDictionary class]])
+		return nil;
+
+	UInt8 kind = ((const UInt8 *)_containerKinds.bytes)[_containerKinds.length-1];
+
+	if (kind == '[') return parent[TK_SCHEMA_ELEMENTS];
+
+	id node = _keyNode;
+	_keyNode = nil;
+
+	return node;
+}
+
+- (void)pushContainer:(UInt8)kind node:(id)node
+{
+	[_nodes addObject:([node isKindOfClass:[NSDictionary class]]) ? node : [NSNull null]];
+	[_containerKinds appendBytes:&kind length:1];
+}
+
+- (void)popContainer
+{
+	[_nodes removeLastObject];
+	_containerKinds.length -= 1;
+
+	// Element object finished
+	if (!_nodes.count && _rowOpen) {
+		[self commitRow];
+		_rowOpen = NO;
+	}
+}
+
+
+#pragma mark Rows
+
+
+- (void)commitRow
+{
+	TKPlacesStoreRow *row = _row;
+
+	// Same requirements as `-[TKPlace initFromResponse:]`
+	if (!row->_ID || !row->_name || isnan(row->_latitude) || isnan(row->_longitude))
+		return;
+
+	[_store appendRow:row];
+}
+
+- (void)setValue:(id)value forColumn:(TKPlacesColumn)column
+{
+	TKPlacesStoreRow *row = _row;
+
+	NSString *string = ([value isKindOfClass:[NSString class]]) ? value : nil;
+	NSNumber *number = ([value isKindOfClass:[NSNumber class]]) ? value : nil;
+
+	switch (column)
+	{
+		case TKPlacesColumnID: row->_ID = string; break;
+		case TKPlacesColumnName: row->_name = string; break;
+		case TKPlacesColumnSuffix: row->_suffix = string; break;
+		case TKPlacesColumnPerex: row->_perex = string; break;
+		case TKPlacesColumnThumbnail: row->_thumbnail = string; break;
+		case TKPlacesColumnQuadKey: row->_quadKey = string; break;
+		case TKPlacesColumnKind: row->_kind = string; break;
+		case TKPlacesColumnMarker: row->_marker = string; break;
+
+		case TKPlacesColumnLevel:
+			if (string) row->_level = _levelsByString[string].unsignedIntegerValue;
+			break;
+
+		case TKPlacesColumnLatitude: if (number) row->_latitude = number.doubleValue; break;
+		case TKPlacesColumnLongitude: if (number) row->_longitude = number.doubleValue; break;
+		case TKPlacesColumnBoxSouth: if (number) row->_box[0] = number.doubleValue; break;
+		case TKPlacesColumnBoxWest: if (number) row->_box[1] = number.doubleValue; break;
+		case TKPlacesColumnBoxNorth: if (number) row->_box[2] = number.doubleValue; break;
+		case TKPlacesColumnBoxEast: if (number) row->_box[3] = number.doubleValue; break;
+		case TKPlacesColumnRating: if (number) row->_rating = number.floatValue; break;
+
+		case TKPlacesColumnCategory:
+			if (string) row->_categories |= _categoriesBySlug[string].unsignedIntegerValue;
+			break;
+
+		case TKPlacesColumnParent:
+			if (!string) break;
+			if (!row->_parents) row->_parents = [NSMutableArray arrayWithCapacity:4];
+			[row->_parents addObject:string];
+			break;
+
+		case TKPlacesColumnDescriptionProvider:
+			if ([string isEqualToString:@"wikipedia"])
+				row->_flags |= TKPlacesStoreFlagWikipediaDescription;
+			break;
+
+		case TKPlacesColumnShapeGeometry:
+			if (number.boolValue) row->_flags |= TKPlacesStoreFlagShapeGeometry;
+			break;
+	}
+}
+
+
+#pragma mark Parser delegate
+
+
+- (void)parserDidStartObject:(__unused TKJSONStreamParser *)parser
+{
+	// New element of the places array
+	if (!_nodes.count) {
+		[_row reset];
+		_rowOpen = YES;
+		[self pushContainer:'{' node:TKPlacesStoreSchema()];
+		return;
+	}
+
+	[self pushContainer:'{' node:[self takeTargetNode]];
+}
+
+- (void)parserDidEndObject:(__unused TKJSONStreamParser *)parser
+{
+	[self popContainer];
+}
+
+- (void)parserDidStartArray:(__unused TKJSONStreamParser *)parser
+{
+	[self pushContainer:'[' node:[self takeTargetNode]];
+}
+
+- (void)parserDidEndArray:(__unused TKJSONStreamParser *)parser
+{
+	[self popContainer];
+}
+
+- (void)parser:(__unused TKJSONStreamParser *)parser didFindKey:(NSString *)key
+{
+	NSDictionary *node = _nodes.lastObject;
+	_keyNode = ([node isKindOfClass:[NSDictionary class]]) ? node[key] : nil;
+}
+
+- (void)parser:(__unused TKJSONStreamParser *)parser didFindValue:(id)value
+{
+	id node = [self takeTargetNode];
+
+	if ([node isKindOfClass:[NSNumber class]])
+		[self setValue:value forColumn:[node unsignedIntegerValue]];
+}
+
+@end
+
+
+#pragma mark - Store array -
+
+
+@implementation TKPlacesStoreArray
+{
+	NSData *_indexes;
+	NSUInteger _count;
+}
+
+- (instancetype)initWithStore:(TKPlacesStore *)store indexes:(NSData *)indexes
+{
+	if (self = [super init])
+	{
+		_store = store;
+		_indexes = [indexes copy];
+		_count = (indexes) ? indexes.length / sizeof(NSUInteger) : store.count;
+	}
+
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return _count;
+}
+
+- (NSUInteger)storeIndexAtIndex:(NSUInteger)index
+{
+	if (index >= _count)
+		[NSException raise:NSRangeException format:@"Index %tu beyond bounds [0 .. %tu]", index, _count];
+
+	return (_indexes) ? ((const NSUInteger *)_indexes.bytes)[index] : index;
+}
+
+- (TKPlace *)objectAtIndex:(NSUInteger)index
+{
+	return [_store placeAtIndex:[self storeIndexAtIndex:index]];
+}
+
+@end
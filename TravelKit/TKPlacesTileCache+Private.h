@@ -0,0 +1,70 @@
+//
+//  TKPlacesTileCache+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <TravelKit/TKPlace.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Cached places of a single map tile.
+@interface TKPlacesTileRecord : NSObject
+
+@property (nonatomic, copy) NSString *key;
+@property (nonatomic, copy, nullable) NSString *ETag;
+@property (nonatomic, strong) NSDate *expirationDate;
+@property (nonatomic, copy) NSArray<TKPlace *> *places;
+
+/// States whether the record holds all places of the tile matching the query,
+/// making it usable for answering queries for any of the tile descendants.
+@property (atomic) BOOL complete;
+
+@property (nonatomic, readonly) BOOL expired;
+
+@end
+
+
+/**
+ Persistent cache of places query results stored per map tile in the database.
+
+ Records are keyed by a canonical signature of the query without tiles combined with
+ the tile key. Expired records are kept for revalidation and offline use until they
+ get evicted by the least-recently-used policy once the byte budget is exceeded.
+ */
+@interface TKPlacesTileCache : NSObject
+
+/// Shared instance
+@property (class, readonly, strong) TKPlacesTileCache *sharedCache;
+
+/// Time-to-live of records lacking explicit freshness information. Defaults to 1 day.
+@property (atomic) NSTimeInterval defaultTimeToLive;
+
+/// Maximal size of the stored data. Defaults to 16 MB.
+@property (atomic) NSUInteger byteBudget;
+
+/// Disqualified initializer
++ (instancetype)new  UNAVAILABLE_ATTRIBUTE;
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+/// Asynchronously fetches records for the given keys, missing records are left out.
+- (void)fetchRecordsForKeys:(NSArray<NSString *> *)keys
+	completion:(void (^)(NSDictionary<NSString *, TKPlacesTileRecord *> *records))completion;
+
+/// Stores the raw place items of a tile, each encoded as a JSON object.
+/// `maxAge` of `0` uses the default time-to-live.
+- (void)storeItems:(NSArray<NSData *> *)items forKey:(NSString *)key
+	ETag:(nullable NSString *)ETag maxAge:(NSTimeInterval)maxAge complete:(BOOL)complete;
+
+/// Extends the lifetime of a record revalidated by the server.
+- (void)refreshRecordForKey:(NSString *)key maxAge:(NSTimeInterval)maxAge;
+
+/// Removes all stored records.
+- (void)removeAllRecords;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,295 @@
+//
+//  TKPlacesTileCache.m
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <TravelKit/NSObject+Parsing.h>
+
+#import "TKPlacesTileCache+Private.h"
+#import "TKPlace+Private.h"
+#import "TKDatabaseManager+Private.h"
+
+
+// Maximal number of keys bound to a single statement
+static const NSUInteger kTKPlacesTileCacheKeysChunk = 200;
+
+// Fraction of the byte budget the cache is trimmed to when exceeded
+static const double kTKPlacesTileCacheTrimRatio = 0.9;
+
+/// Comma-separated list of `count` statement placeholders
+static NSString *TKPlacesTileCachePlaceholders(NSUInteger count)
+{
+	NSMutableString *placeholders = [NSMutableString stringWithCapacity:2 * count];
+
+	for (NSUInteger i = 0; i < count; i++)
+		[placeholders appendString:(i) ? @",?" : @"?"];
+
+	return placeholders;
+}
+
+
+#pragma mark Tile record -
+
+
+@implementation TKPlacesTileRecord
+
+- (BOOL)expired
+{
+	return _expirationDate.timeIntervalSinceNow <= 0;
+}
+
+@end
+
+
+#pragma mark - Tile cache -
+
+
+@implementation TKPlacesTileCache
+{
+	dispatch_queue_t _queue;
+	NSUInteger _storedBytes;
+	BOOL _storedBytesKnown;
+}
+
++ (TKPlacesTileCache *)sharedCache
+{
+	static TKPlacesTileCache *shared = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		shared = [[self alloc] init];
+	});
+
+	return shared;
+}
+
+- (instancetype)init
+{
+	if (self = [super init])
+	{
+		_queue = dispatch_queue_create("TravelKit.PlacesTileCache", DISPATCH_QUEUE_SERIAL);
+		_defaultTimeToLive = 24 * 60 * 60;
+		_byteBudget = 16 * 1024 * 1024;
+	}
+
+	return self;
+}
+
+
+#pragma mark -
+#pragma mark Helpers
+
+
+- (void)enumerateKeyChunks:(NSArray<NSString *> *)keys usingBlock:(void (^)(NSArray<NSString *> *chunk))block
+{
+	for (NSUInteger i = 0; i < keys.count; i += kTKPlacesTileCacheKeysChunk)
+		block([keys subarrayWithRange:NSMakeRange(i, MIN(kTKPlacesTileCacheKeysChunk, keys.count - i))]);
+}
+
+
+#pragma mark -
+#pragma mark Records
+
+
+- (void)fetchRecordsForKeys:(NSArray<NSString *> *)keys
+	completion:(void (^)(NSDictionary<NSString *, TKPlacesTileRecord *> *))completion
+{
+	keys = [keys copy];
+
+	dispatch_async(_queue, ^{
+
+		NSMutableDictionary<NSString *, TKPlacesTileRecord *> *records =
+			[NSMutableDictionary dictionaryWithCapacity:keys.count];
+
+		@try {
+
+			TKDatabaseManager *database = [TKDatabaseManager sharedManager];
+			NSNumber *now = @([NSDate new].timeIntervalSince1970);
+
+			[self enumerateKeyChunks:keys usingBlock:^(NSArray<NSString *> *chunk) {
+
+				NSString *placeholders = TKPlacesTileCachePlaceholders(chunk.count);
+
+				NSString *sql = [NSString stringWithFormat:@"SELECT key, etag, expires_at, complete, data "
+					"FROM %%@ WHERE key IN (%@);", placeholders];
+
+				NSArray<NSDictionary *> *rows = [database runQuery:sql
+					tableName:kTKDatabaseTablePlacesTiles data:chunk];
+
+				for (NSDictionary *row in rows)
+				{
+					NSString *key = [row[@"key"] parsedString];
+					NSData *data = row[@"data"];
+					if (!key || ![data isKindOfClass:[NSData class]]) continue;
+
+					NSArray *items = [[NSJSONSerialization JSONObjectWithData:data
+						options:kNilOptions error:nil] parsedArray];
+					if (!items) continue;
+
+					NSMutableArray<TKPlace *> *places = [NSMutableArray arrayWithCapacity:items.count];
+
+					for (NSDictionary *item in items) {
+						if (![item parsedDictionary]) continue;
+						TKPlace *place = [[TKPlace alloc] initFromResponse:item];
+						if (place) [places addObject:place];
+					}
+
+					TKPlacesTileRecord *record = [TKPlacesTileRecord new];
+					record.key = key;
+					record.ETag = [row[@"etag"] parsedString];
+					record.expirationDate = [NSDate dateWithTimeIntervalSince1970:
+						[[row[@"expires_at"] parsedNumber] doubleValue]];
+					record.places = places;
+					record.complete = [[row[@"complete"] parsedNumber] boolValue];
+
+					records[key] = record;
+				}
+
+				// Touch the records for the eviction policy
+				if (rows.count)
+					[database runUpdate:[NSString stringWithFormat:@"UPDATE %%@ SET accessed_at = ? "
+						"WHERE key IN (%@);", placeholders] tableName:kTKDatabaseTablePlacesTiles
+							data:[@[ now ] arrayByAddingObjectsFromArray:chunk]];
+			}];
+		}
+		@catch (__unused id exception) { }
+
+		if (completion) completion(records);
+	});
+}
+
+- (void)storeItems:(NSArray<NSData *> *)items forKey:(NSString *)key
+	ETag:(NSString *)ETag maxAge:(NSTimeInterval)maxAge complete:(BOOL)complete
+{
+	if (!key) return;
+
+	// Join the encoded items into a JSON array
+	NSUInteger length = 2;
+	for (NSData *item in items) length += item.length + 1;
+
+	NSMutableData *data = [NSMutableData dataWithCapacity:length];
+	[data appendBytes:"[" length:1];
+
+	[items enumerateObjectsUsingBlock:^(NSData *item, NSUInteger idx, BOOL *__unused stop) {
+		if (idx) [data appendBytes:"," length:1];
+		[data appendData:item];
+	}];
+
+	[data appendBytes:"]" length:1];
+
+	if (maxAge <= 0) maxAge = self.defaultTimeToLive;
+
+	dispatch_async(_queue, ^{
+
+		@try {
+
+			NSTimeInterval now = [NSDate new].timeIntervalSince1970;
+
+			[[TKDatabaseManager sharedManager] runUpdate:@"INSERT OR REPLACE INTO %@ "
+				"(key, etag, fetched_at, expires_at, accessed_at, complete, size, data) VALUES (?,?,?,?,?,?,?,?);"
+				tableName:kTKDatabaseTablePlacesTiles data:@[ key, ETag ?: [NSNull null],
+					@(now), @(now + maxAge), @(now), @(complete), @(data.length), data ]];
+
+			self->_storedBytes += data.length;
+
+			[self trimToBudgetIfNeeded];
+		}
+		@catch (__unused id exception) { }
+	});
+}
+
+- (void)refreshRecordForKey:(NSString *)key maxAge:(NSTimeInterval)maxAge
+{
+	if (maxAge <= 0) maxAge = self.defaultTimeToLive;
+
+	dispatch_async(_queue, ^{
+
+		@try {
+
+			NSTimeInterval now = [NSDate new].timeIntervalSince1970;
+
+			[[TKDatabaseManager sharedManager] runUpdate:@"UPDATE %@ SET expires_at = ?, accessed_at = ? "
+				"WHERE key = ?;" tableName:kTKDatabaseTablePlacesTiles data:@[ @(now + maxAge), @(now), key ]];
+		}
+		@catch (__unused id exception) { }
+	});
+}
+
+- (void)removeAllRecords
+{
+	dispatch_async(_queue, ^{
+
+		@try {
+			[[TKDatabaseManager sharedManager] runUpdate:@"DELETE FROM %@;"
+				tableName:kTKDatabaseTablePlacesTiles];
+			self->_storedBytes = 0;
+			self->_storedBytesKnown = YES;
+		}
+		@catch (__unused id exception) { }
+	});
+}
+
+
+#pragma mark -
+#pragma mark Eviction
+
+
+- (NSUInteger)measureStoredBytes
+{
+	NSDictionary *row = [[[TKDatabaseManager sharedManager] runQuery:@"SELECT SUM(size) AS total FROM %@;"
+		tableName:kTKDatabaseTablePlacesTiles] firstObject];
+
+	return [[row[@"total"] parsedNumber] unsignedIntegerValue];
+}
+
+- (void)trimToBudgetIfNeeded
+{
+	NSUInteger budget = self.byteBudget;
+
+	// Replaced records make the running total an over-estimate,
+	// measure the exact value before evicting anything
+	if (!_storedBytesKnown || _storedBytes > budget) {
+		_storedBytes = [self measureStoredBytes];
+		_storedBytesKnown = YES;
+	}
+
+	if (_storedBytes <= budget) return;
+
+	TKDatabaseManager *database = [TKDatabaseManager sharedManager];
+	NSUInteger target = (NSUInteger)(budget * kTKPlacesTileCacheTrimRatio);
+
+	while (_storedBytes > target)
+	{
+		NSArray<NSDictionary *> *rows = [database runQuery:[NSString stringWithFormat:
+			@"SELECT key, size FROM %%@ ORDER BY accessed_at ASC LIMIT %tu;", kTKPlacesTileCacheKeysChunk]
+				tableName:kTKDatabaseTablePlacesTiles];
+
+		if (!rows.count) break;
+
+		NSMutableArray<NSString *> *evicted = [NSMutableArray arrayWithCapacity:rows.count];
+		NSUInteger evictedBytes = 0;
+
+		for (NSDictionary *row in rows)
+		{
+			if (_storedBytes - evictedBytes <= target) break;
+
+			NSString *key = [row[@"key"] parsedString];
+			if (!key) continue;
+
+			[evicted addObject:key];
+			evictedBytes += [[row[@"size"] parsedNumber] unsignedIntegerValue];
+		}
+
+		if (!evicted.count) break;
+
+		[database runUpdate:[NSString stringWithFormat:@"DELETE FROM %%@ WHERE key IN (%@);",
+			TKPlacesTileCachePlaceholders(evicted.count)] tableName:kTKDatabaseTablePlacesTiles data:evicted];
+
+		_storedBytes -= MIN(evictedBytes, _storedBytes);
+	}
+}
+
+@end
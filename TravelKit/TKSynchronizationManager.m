@@ -239,6 +239,7 @@ typedef NS_ENUM(NSUInteger, TKSynchronizationNotificationType) {
 - (void)enqueueRequest:(TKAPIRequest *)request
 {
 	request.accessToken = _currentAccessToken;
+	request.priority = TKAPIRequestPrioritySync;
 	[_requests addObject:request];
 	[request start];
 }
@@ -580,8 +581,7 @@ typedef NS_ENUM(NSUInteger, TKSynchronizationNotificationType) {
 			[self enqueueRequest:[[TKAPIRequest alloc] initAsBatchTripRequestForIDs:
 			  storedIDs.allObjects success:^(NSArray<TKTrip *> *trips) {
 
-				for (TKTrip *t in trips)
-					[self processResponseWithTrip:t sentTripID:t.ID];
+				[self processResponseWithTrips:trips];
 
 				[self checkState];
 
@@ -621,6 +621,15 @@ typedef NS_ENUM(NSUInteger, TKSynchronizationNotificationType) {
 	[_trips storeTrip:trip];
 }
 
+- (void)processResponseWithTrips:(NSArray<TKTrip *> *)trips
+{
+	for (TKTrip *trip in trips)
+		SyncLog(@"Processing Trip: %@", trip);
+
+	// Store the whole batch at once
+	[_trips storeTrips:trips];
+}
+
 
 #pragma mark - Actions
 
@@ -8,6 +8,7 @@
 
 #import <TravelKit/TKToursManager.h>
 #import "TKAPI+Private.h"
+#import "TKToursQuery+Private.h"
 
 
 @implementation TKToursManager
@@ -27,7 +28,7 @@
 - (void)toursForViatorQuery:(TKToursViatorQuery *)query
                  completion:(void (^)(NSArray<TKTour *> * _Nullable, NSError * _Nullable))completion
 {
-	static NSCache<NSNumber *, NSArray<TKTour *> *> *toursCache = nil;
+	static NSCache<NSString *, NSArray<TKTour *> *> *toursCache = nil;
 
 	static dispatch_once_t onceToken;
 	dispatch_once(&onceToken, ^{
@@ -35,7 +36,9 @@
 		toursCache.countLimit = 32;
 	});
 
-	NSArray *cached = [toursCache objectForKey:@(query.hash)];
+	NSString *cacheKey = query.digest;
+
+	NSArray *cached = [toursCache objectForKey:cacheKey];
 	if (cached) {
 		if (completion)
 			completion(cached, nil);
@@ -44,7 +47,7 @@
 
 	[[[TKAPIRequest alloc] initAsViatorToursRequestForQuery:query success:^(NSArray<TKTour *> *tours) {
 
-		[toursCache setObject:tours forKey:@(query.hash)];
+		[toursCache setObject:tours forKey:cacheKey];
 
 		if (completion)
 			completion(tours, nil);
@@ -60,7 +63,7 @@
 - (void)toursForGYGQuery:(TKToursGYGQuery *)query
               completion:(void (^)(NSArray<TKTour *> * _Nullable, NSError * _Nullable))completion
 {
-	static NSCache<NSNumber *, NSArray<TKTour *> *> *toursCache = nil;
+	static NSCache<NSString *, NSArray<TKTour *> *> *toursCache = nil;
 
 	static dispatch_once_t onceToken;
 	dispatch_once(&onceToken, ^{
@@ -68,7 +71,9 @@
 		toursCache.countLimit = 32;
 	});
 
-	NSArray *cached = [toursCache objectForKey:@(query.hash)];
+	NSString *cacheKey = query.digest;
+
+	NSArray *cached = [toursCache objectForKey:cacheKey];
 	if (cached) {
 		if (completion)
 			completion(cached, nil);
@@ -77,7 +82,7 @@
 
 	[[[TKAPIRequest alloc] initAsGYGToursRequestForQuery:query success:^(NSArray<TKTour *> *tours) {
 
-		[toursCache setObject:tours forKey:@(query.hash)];
+		[toursCache setObject:tours forKey:cacheKey];
 
 		if (completion)
 			completion(tours, nil);
@@ -0,0 +1,34 @@
+//
+//  TKToursQuery+Private.h
+//  TravelKit
+//
+//  Created by agent on 18/10/2026.
+//  Copyright © 2026 Tripomatic. All rights reserved.
+//
+
+#import <TravelKit/TKToursQuery.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+@interface TKToursViatorQuery ()
+
+/// Canonical, order-normalized binary serialization of the query
+@property (nonatomic, copy, readonly) NSData *canonicalData;
+
+/// Hex-encoded 128-bit digest of `canonicalData`, used as a key of result caches
+@property (nonatomic, copy, readonly) NSString *digest;
+
+@end
+
+
+@interface TKToursGYGQuery ()
+
+/// Canonical, order-normalized binary serialization of the query
+@property (nonatomic, copy, readonly) NSData *canonicalData;
+
+/// Hex-encoded 128-bit digest of `canonicalData`, used as a key of result caches
+@property (nonatomic, copy, readonly) NSString *digest;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -6,7 +6,8 @@
 //  Copyright © 2017 Tripomatic. All rights reserved.
 //
 
-#import <TravelKit/TKToursQuery.h>
+#import "TKToursQuery+Private.h"
+#import "TKCanonicalEncoder+Private.h"
 
 @implementation TKToursViatorQuery
 
@@ -16,6 +17,23 @@
 	_descendingSortingOrder = (sortingType != TKToursViatorQuerySortingPrice);
 }
 
+- (NSData *)canonicalData
+{
+	TKCanonicalEncoder *encoder = [TKCanonicalEncoder new];
+
+	[encoder encodeString:_parentID forField:1];
+	[encoder encodeUnsignedInteger:_sortingType forField:2];
+	[encoder encodeBool:_descendingSortingOrder forField:3];
+	[encoder encodeNumber:_pageNumber forField:4];
+
+	return encoder.data;
+}
+
+- (NSString *)digest
+{
+	return [TKCanonicalEncoder digestForData:self.canonicalData];
+}
+
 - (NSUInteger)hash
 {
 	NSMutableString *key = [@"viator" mutableCopy];
@@ -66,6 +84,30 @@
 	_descendingSortingOrder = (sortingType != TKToursGYGQuerySortingPrice && sortingType != TKToursGYGQuerySortingDuration);
 }
 
+- (NSData *)canonicalData
+{
+	TKCanonicalEncoder *encoder = [TKCanonicalEncoder new];
+
+	[encoder encodeString:_parentID forField:1];
+	[encoder encodeUnsignedInteger:_sortingType forField:2];
+	[encoder encodeBool:_descendingSortingOrder forField:3];
+	[encoder encodeDate:_startDate forField:4];
+	[encoder encodeDate:_endDate forField:5];
+	[encoder encodeNumber:_minimalDuration forField:6];
+	[encoder encodeNumber:_maximalDuration forField:7];
+	[encoder encodeString:_searchTerm forField:8];
+	[encoder encodeRegion:_bounds forField:9];
+	[encoder encodeNumber:_count forField:10];
+	[encoder encodeNumber:_pageNumber forField:11];
+
+	return encoder.data;
+}
+
+- (NSString *)digest
+{
+	return [TKCanonicalEncoder digestForData:self.canonicalData];
+}
+
 - (NSUInteger)hash
 {
 	NSMutableString *key = [@"gyg" mutableCopy];
@@ -97,6 +139,7 @@
 	query.endDate = _endDate;
 	query.minimalDuration = _minimalDuration;
 	query.maximalDuration = _maximalDuration;
+	query.bounds = _bounds;
 
 	return query;
 }
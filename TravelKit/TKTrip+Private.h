@@ -12,6 +12,8 @@ NS_ASSUME_NONNULL_BEGIN
 
 #define LOCAL_TRIP_PREFIX         "*"
 
+@class TKDatabaseRow;
+
 
 ///-----------------------------------------------------------------------------
 #pragma mark - Trip definitions
@@ -50,7 +52,7 @@ typedef NS_OPTIONS(NSUInteger, TKTripRights) {
 
 // Handled initializers
 - (instancetype)initFromResponse:(NSDictionary *)dict;
-- (instancetype)initFromDatabase:(NSDictionary *)dict;
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row;
 
 @end
 
@@ -64,8 +66,7 @@ typedef NS_OPTIONS(NSUInteger, TKTripRights) {
 
 // Handled initializers
 - (instancetype)initFromResponse:(NSDictionary *)dict;
-- (instancetype)initFromDatabase:(NSDictionary *)dict
-					   itemDicts:(NSArray<NSDictionary *> *)itemDicts;
+- (instancetype)initWithNote:(nullable NSString *)note items:(NSArray<TKTripDayItem *> *)items;
 
 @end
 
@@ -97,15 +98,14 @@ typedef NS_OPTIONS(NSUInteger, TKTripRights) {
 - (instancetype)initFromResponse:(NSDictionary *)dict;
 
 /**
- * Init object from dictionary taken from SQL
+ * Init object from a row of the Trips table
  *
- * @param dict Trip dictionary from database
- * @param dayItemDicts Day Item dictionary objects from database
+ * @param row Trip row from database
+ * @param days Days stored for the Trip, keyed by their index
  * @return Trip object with filled information
  */
-- (instancetype)initFromDatabase:(NSDictionary *)dict
-                        dayDicts:(NSArray<NSDictionary *> *)dayDicts
-                    dayItemDicts:(NSArray<NSDictionary *> *)dayItemDicts;
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row
+                               days:(NSDictionary<NSNumber *, TKTripDay *> *)days;
 
 // Serialization methods
 - (NSDictionary *)asRequestDictionary;
@@ -131,7 +131,7 @@ typedef NS_OPTIONS(NSUInteger, TKTripRights) {
 
 @property (nonatomic, assign) BOOL changed;
 
-- (instancetype)initFromDatabase:(NSDictionary *)dict;
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row;
 
 @end
 
@@ -149,6 +149,19 @@ typedef NS_OPTIONS(NSUInteger, TKTripRights) {
 @end
 
 
+///-----------------------------------------------------------------------------
+#pragma mark - Trip item occurrence model
+///-----------------------------------------------------------------------------
+
+
+@interface TKTripItemOccurrence ()
+
+- (instancetype)initWithItemID:(NSString *)itemID tripID:(NSString *)tripID
+                      dayIndex:(NSUInteger)dayIndex itemIndex:(NSUInteger)itemIndex;
+
+@end
+
+
 ///-----------------------------------------------------------------------------
 #pragma mark - Trip collaborator model
 ///-----------------------------------------------------------------------------
@@ -233,4 +233,33 @@ NS_ASSUME_NONNULL_BEGIN
 
 @end
 
+
+///-----------------------------------------------------------------------------
+#pragma mark -
+#pragma mark Trip item occurrence object
+///-----------------------------------------------------------------------------
+
+
+/**
+ Trip Item Occurrence model.
+
+ Position of a place planned in a locally stored Trip, as found by the lookups
+ of the Trips manager without loading the Trips themselves.
+ */
+@interface TKTripItemOccurrence : NSObject
+
+/// ID of the place.
+@property (nonatomic, copy, readonly) NSString *itemID;
+/// ID of the Trip the place is planned in.
+@property (nonatomic, copy, readonly) NSString *tripID;
+/// Index of the Trip Day the place is planned on.
+@property (nonatomic, readonly) NSUInteger dayIndex;
+/// Index of the item within the Trip Day.
+@property (nonatomic, readonly) NSUInteger itemIndex;
+
++ (instancetype)new UNAVAILABLE_ATTRIBUTE;
+- (instancetype)init UNAVAILABLE_ATTRIBUTE;
+
+@end
+
 NS_ASSUME_NONNULL_END
@@ -12,6 +12,7 @@
 #import <TravelKit/TKMapWorker.h>
 
 #import "TKTrip+Private.h"
+#import "TKDatabaseManager+Private.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -67,27 +68,27 @@
 	        [[self asRequestDictionary] isEqual:[object asRequestDictionary]]);
 }
 
-- (instancetype)initFromDatabase:(NSDictionary *)dict
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row
 {
-	NSString *placeID = [dict[@"item_id"] parsedString];
+	NSString *placeID = [row stringForColumn:@"item_id"];
 
 	if (!placeID) return nil;
 
 	if (self = [super init])
 	{
 		_placeID = placeID;
-		_duration = [dict[@"duration"] parsedNumber];
-		_note = [dict[@"note"] parsedString];
-		_startTime = [dict[@"start_time"] parsedNumber];
-
-		_transportMode = [[dict[@"transport_mode"] parsedNumber] unsignedIntegerValue];
-		_transportAvoid = [[dict[@"transport_avoid"] parsedNumber] unsignedIntegerValue];
-		_transportStartTime = [dict[@"transport_start_time"] parsedNumber];
-		_transportDuration = [dict[@"transport_duration"] parsedNumber];
-		_transportNote = [dict[@"transport_note"] parsedString];
-		_transportRouteID = [dict[@"transport_route_id"] parsedString];
-
-		_transportPolyline = [dict[@"transport_polyline"] parsedString];
+		_duration = [row integerNumberForColumn:@"duration"];
+		_note = [row stringForColumn:@"note"];
+		_startTime = [row integerNumberForColumn:@"start_time"];
+
+		_transportMode = (TKTripTransportMode)[row integerForColumn:@"transport_mode"];
+		_transportAvoid = (TKDirectionAvoidOption)[row integerForColumn:@"transport_avoid"];
+		_transportStartTime = [row integerNumberForColumn:@"transport_start_time"];
+		_transportDuration = [row integerNumberForColumn:@"transport_duration"];
+		_transportNote = [row stringForColumn:@"transport_note"];
+		_transportRouteID = [row stringForColumn:@"transport_route_id"];
+
+		_transportPolyline = [row stringForColumn:@"transport_polyline"];
 	}
 
 	return self;
@@ -265,22 +266,11 @@
 	return self;
 }
 
-- (instancetype)initFromDatabase:(NSDictionary *)dict
-				itemDicts:(NSArray<NSDictionary *> *)itemDicts
+- (instancetype)initWithNote:(NSString *)note items:(NSArray<TKTripDayItem *> *)items
 {
 	if (self = [super init])
 	{
-		_note = [dict[@"note"] parsedString];
-
-		NSMutableArray *items = [NSMutableArray arrayWithCapacity:10];
-
-		for (NSDictionary *itemDict in itemDicts)
-		{
-			if (![itemDict parsedDictionary]) continue;
-			TKTripDayItem *item = [[TKTripDayItem alloc] initFromDatabase:itemDict];
-			if (item) [items addObject:item];
-		}
-
+		_note = note;
 		_items = [items copy];
 	}
 
@@ -395,11 +385,10 @@
 	return self;
 }
 
-- (instancetype)initFromDatabase:(NSDictionary *)dict
-                        dayDicts:(NSArray<NSDictionary *> *)dayDicts
-                    dayItemDicts:(NSArray<NSDictionary *> *)dayItemDicts
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row
+                               days:(NSDictionary<NSNumber *, TKTripDay *> *)storedDays
 {
-	NSString *ID = [dict[@"id"] parsedString];
+	NSString *ID = [row stringForColumn:@"id"];
 
 	if (!ID) return nil;
 
@@ -409,43 +398,33 @@
 
 		// Basic attributes
 
-		_name = [dict[@"name"] parsedString] ?: @"";
-		_version = [[dict[@"version"] parsedNumber] unsignedIntegerValue] ?: 1;
-		_ownerID = [dict[@"owner_id"] parsedString];
+		_name = [row stringForColumn:@"name"] ?: @"";
+		_version = (NSUInteger)[row integerForColumn:@"version"] ?: 1;
+		_ownerID = [row stringForColumn:@"owner_id"];
 
-		NSString *stored = [dict[@"starts_on"] parsedString];
+		NSString *stored = [row stringForColumn:@"starts_on"];
 		if (stored) _startDate = [NSDate dateFromDateString:stored];
 
-		stored = [dict[@"updated_at"] parsedString];
+		stored = [row stringForColumn:@"updated_at"];
 		if (stored) _lastUpdate = [NSDate dateFrom8601DateTimeString:stored];
 
-		_changed = [[dict[@"changed"] parsedNumber] boolValue];
-		_deleted = [[dict[@"deleted"] parsedNumber] boolValue];
+		_changed = [row integerForColumn:@"changed"] != 0;
+		_deleted = [row integerForColumn:@"deleted"] != 0;
 
-		_privacy = [dict[@"privacy"] unsignedIntegerValue];
-		_rights  = [dict[@"rights"]  unsignedIntegerValue];
+		_privacy = (TKTripPrivacy)[row integerForColumn:@"privacy"];
+		_rights  = (TKTripRights)[row integerForColumn:@"rights"];
 
 		// Days
-		NSUInteger daysCount = [[dict[@"days"] parsedNumber] unsignedIntegerValue];
+		NSUInteger daysCount = (NSUInteger)[row integerForColumn:@"days"];
 
-		NSMutableArray<TKTripDay *> *days = [NSMutableArray arrayWithCapacity:10];
+		NSMutableArray<TKTripDay *> *days = [NSMutableArray arrayWithCapacity:daysCount];
 
 		for (NSUInteger dayIndex = 0; dayIndex < daysCount; dayIndex++)
-		{
-			NSDictionary *dayDict = [[dayDicts filteredArrayUsingBlock:^BOOL(NSDictionary *d) {
-				return [[d[@"day_index"] parsedNumber] unsignedIntegerValue] == dayIndex;
-			}] firstObject];
-
-			NSArray<NSDictionary *> *itemDicts = [dayItemDicts filteredArrayUsingBlock:^BOOL(NSDictionary *it) {
-				return [[it[@"day_index"] parsedNumber] unsignedIntegerValue] == dayIndex;
-			}];
-
-			[days addObject:( [[TKTripDay alloc] initFromDatabase:dayDict itemDicts:itemDicts] ?: [TKTripDay new] )];
-		}
+			[days addObject:( storedDays[@(dayIndex)] ?: [TKTripDay new] )];
 
 		_days = [days copy];
 
-		_destinationIDs = [[dict[@"destination_ids"] parsedString] componentsSeparatedByString:@"|"] ?: @[ ];
+		_destinationIDs = [[row stringForColumn:@"destination_ids"] componentsSeparatedByString:@"|"] ?: @[ ];
 	}
 
 	return self;
@@ -646,11 +625,11 @@
 
 @implementation TKTripInfo
 
-- (instancetype)initFromDatabase:(NSDictionary *)dict
+- (instancetype)initFromDatabaseRow:(TKDatabaseRow *)row
 {
-	NSString *ID = [dict[@"id"] parsedString];
-	NSString *name = [dict[@"name"] parsedString];
-	NSString *ownerID = [dict[@"owner_id"] parsedString];
+	NSString *ID = [row stringForColumn:@"id"];
+	NSString *name = [row stringForColumn:@"name"];
+	NSString *ownerID = [row stringForColumn:@"owner_id"];
 
 	if (!ID || !name || !ownerID)
 		return nil;
@@ -659,23 +638,23 @@
 	{
 		_ID = ID;
 		_name = name;
-		_version = [[dict[@"version"] parsedNumber] unsignedIntegerValue];
-		_daysCount = [[dict[@"days"] parsedNumber] unsignedIntegerValue];
+		_version = (NSUInteger)[row integerForColumn:@"version"];
+		_daysCount = (NSUInteger)[row integerForColumn:@"days"];
 		_ownerID = ownerID;
 
-		_destinationIDs = [[dict[@"destination_ids"] parsedString]
+		_destinationIDs = [[row stringForColumn:@"destination_ids"]
 			componentsSeparatedByString:@"|"] ?: @[ ];
 
-		NSString *stored = [dict[@"starts_on"] parsedString];
+		NSString *stored = [row stringForColumn:@"starts_on"];
 		if (stored) _startDate = [NSDate dateFromDateString:stored];
-		stored = [dict[@"updated_at"] parsedString];
+		stored = [row stringForColumn:@"updated_at"];
 		if (stored) _lastUpdate = [NSDate dateFrom8601DateTimeString:stored];
 
-		_changed = [[dict[@"changed"] parsedNumber] boolValue];
-		_deleted = [[dict[@"deleted"] parsedNumber] boolValue];
+		_changed = [row integerForColumn:@"changed"] != 0;
+		_deleted = [row integerForColumn:@"deleted"] != 0;
 
-		_privacy = [[dict[@"privacy"] parsedNumber] unsignedIntegerValue];
-		_rights = [[dict[@"rights"] parsedNumber] unsignedIntegerValue];
+		_privacy = (TKTripPrivacy)[row integerForColumn:@"privacy"];
+		_rights = (TKTripRights)[row integerForColumn:@"rights"];
 	}
 
 	return self;
@@ -825,3 +804,40 @@
 }
 
 @end
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma mark             - Trip item occurrence implementation -
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+
+@implementation TKTripItemOccurrence
+
+- (instancetype)initWithItemID:(NSString *)itemID tripID:(NSString *)tripID
+                      dayIndex:(NSUInteger)dayIndex itemIndex:(NSUInteger)itemIndex
+{
+	if (!itemID || !tripID)
+		return nil;
+
+	if (self = [super init])
+	{
+		_itemID = [itemID copy];
+		_tripID = [tripID copy];
+		_dayIndex = dayIndex;
+		_itemIndex = itemIndex;
+	}
+
+	return self;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<TripItemOccurrence %p | Item: %@ | Trip: %@ | Day %tu, Item %tu>",
+	        self, _itemID, _tripID, _dayIndex, _itemIndex];
+}
+
+@end
@@ -18,8 +18,8 @@ NS_ASSUME_NONNULL_BEGIN
 #pragma mark - Methods
 
 // Trip database manipulation
-- (BOOL)insertTrip:(TKTrip *)trip;
 - (BOOL)storeTrip:(TKTrip *)trip;
+- (BOOL)storeTrips:(NSArray<TKTrip *> *)trips; // Single transaction, unchanged Day items are kept
 - (BOOL)deleteTripWithID:(NSString *)tripID;
 
 // Datatabse workers
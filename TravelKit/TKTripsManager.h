@@ -127,6 +127,20 @@ NS_ASSUME_NONNULL_BEGIN
  */
 - (NSArray<NSNumber *> *)yearsOfActiveTrips;
 
+#pragma mark - Trip item lookups
+
+/**
+ A method used to find where the given places are planned in locally stored Trips.
+
+ Looks the places up in a single query without loading the Trips. Deleted Trips
+ are skipped.
+
+ @param itemIDs An array of place IDs to look up.
+ @return A dictionary of `TKTripItemOccurrence` arrays keyed by place ID, ordered
+         by Trip, Day and item position. Places not planned in any Trip are left out.
+ */
+- (NSDictionary<NSString *, NSArray<TKTripItemOccurrence *> *> *)occurrencesOfItemsWithIDs:(NSArray<NSString *> *)itemIDs;
+
 #pragma mark - Trip saving
 
 /**
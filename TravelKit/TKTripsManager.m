@@ -15,6 +15,90 @@
 #import "TKAPI+Private.h"
 
 
+// Columns of the stored Trip tables, in the order of the values built below
+#define TRIP_COLUMNS              "id, name, version, days, destination_ids, owner_id, " \
+                                  "starts_on, ends_on, updated_at, changed, deleted, privacy, rights"
+#define TRIP_DAY_COLUMNS          "trip_id, day_index, note"
+#define TRIP_DAY_ITEM_COLUMNS     "trip_id, day_index, item_index, item_id, start_time, duration, " \
+                                  "note, transport_mode, transport_avoid, transport_start_time, " \
+                                  "transport_duration, transport_note, transport_polyline, transport_route_id"
+
+/// Stored date of the last Trip day, kept along with the start date for date range lookups
+static id TKTripsManagerEndsOn(NSDate *startDate, NSUInteger daysCount)
+{
+	return [[startDate dateByAddingNumberOfDays:(NSInteger)MAX(daysCount, 1) - 1] dateString] ?: [NSNull null];
+}
+
+// Number of rows inserted by a single multi-row statement
+static const NSUInteger kTKTripsManagerInsertRowsChunk = 32;
+
+/// Statement inserting or replacing `rowsCount` rows of the given columns
+static NSString *TKTripsManagerInsertQuery(NSString *columns, NSUInteger rowsCount)
+{
+	static NSCache<NSString *, NSString *> *cache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		cache = [NSCache new];
+	});
+
+	NSString *key = [NSString stringWithFormat:@"%tu|%@", rowsCount, columns];
+	NSString *query = [cache objectForKey:key];
+
+	if (query) return query;
+
+	NSUInteger columnsCount = [columns componentsSeparatedByString:@","].count;
+
+	NSMutableString *row = [NSMutableString stringWithCapacity:2 * columnsCount + 2];
+	for (NSUInteger i = 0; i < columnsCount; i++)
+		[row appendString:(i) ? @",?" : @"(?"];
+	[row appendString:@")"];
+
+	NSMutableString *rows = [NSMutableString stringWithCapacity:rowsCount * (row.length + 1)];
+	for (NSUInteger i = 0; i < rowsCount; i++) {
+		if (i) [rows appendString:@","];
+		[rows appendString:row];
+	}
+
+	query = [NSString stringWithFormat:@"INSERT OR REPLACE INTO %%@ (%@) VALUES %@;", columns, rows];
+	[cache setObject:query forKey:key];
+
+	return query;
+}
+
+// Maximal number of place IDs bound to a single occurrences lookup
+static const NSUInteger kTKTripsManagerOccurrencesChunk = 256;
+
+/// Statement looking up occurrences of `count` place IDs in stored Trips.
+/// Placeholder counts are rounded up to a power of two, unused ones are bound to `NULL`
+/// so lookups of similar sizes share a few cached statements.
+static NSString *TKTripsManagerOccurrencesQuery(NSUInteger count)
+{
+	static NSCache<NSNumber *, NSString *> *cache = nil;
+
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		cache = [NSCache new];
+	});
+
+	NSNumber *key = @(count);
+	NSString *query = [cache objectForKey:key];
+
+	if (query) return query;
+
+	NSMutableString *placeholders = [NSMutableString stringWithCapacity:2 * count];
+	for (NSUInteger i = 0; i < count; i++)
+		[placeholders appendString:(i) ? @",?" : @"?"];
+
+	query = [NSString stringWithFormat:@"SELECT i.item_id, i.trip_id, i.day_index, i.item_index "
+		"FROM %%@ i JOIN %@ t ON t.id = i.trip_id WHERE i.item_id IN (%@) AND t.deleted = 0 "
+		"ORDER BY i.trip_id ASC, i.day_index ASC, i.item_index ASC;", kTKDatabaseTableTrips, placeholders];
+	[cache setObject:query forKey:key];
+
+	return query;
+}
+
+
 @interface TKTripsManager ()
 
 @property (nonatomic, strong) TKDatabaseManager *database;
@@ -59,100 +143,129 @@
 #pragma mark - Trip methods
 
 
-- (TKTrip *)tripWithID:(NSString *)tripID
+- (NSDictionary<NSString *, NSDictionary<NSNumber *, TKTripDay *> *> *)storedDaysOfTripWithID:(NSString *)tripID
 {
-	if (!tripID) return nil;
-
-	NSDictionary *tripDict = [[_database runQuery:@"SELECT * FROM %@ WHERE id = ? LIMIT 1;"
-					tableName:kTKDatabaseTableTrips data:@[ tripID ]] lastObject];
+	// Days of a single Trip or of all of them when no ID is given
+	NSArray *data = (tripID) ? @[ tripID ] : nil;
 
-	// If there were no Trips...
-	if (!tripDict) return nil;
+	// Day notes
+	NSMutableDictionary<NSString *, NSMutableDictionary<NSNumber *, NSString *> *> *notes =
+		[NSMutableDictionary dictionaryWithCapacity:16];
 
-	NSArray *dayDicts = [_database runQuery:@"SELECT * FROM %@ WHERE trip_id = ? "
-		"ORDER BY day_index ASC;" tableName:kTKDatabaseTableTripDays data:@[ tripID ]];
+	[_database enumerateQuery:(tripID) ?
+		@"SELECT trip_id, day_index, note FROM %@ WHERE trip_id = ? AND note IS NOT NULL;" :
+		@"SELECT trip_id, day_index, note FROM %@ WHERE note IS NOT NULL;"
+	  tableName:kTKDatabaseTableTripDays data:data usingBlock:^(TKDatabaseRow *row) {
 
-	NSArray *dayItemDicts = [_database runQuery:@"SELECT * FROM %@ WHERE trip_id = ? "
-		"ORDER BY day_index ASC, item_index ASC;" tableName:kTKDatabaseTableTripDayItems data:@[ tripID ]];
+		NSString *dayTripID = [row stringAtIndex:0];
+		if (!dayTripID) return;
 
-	TKTrip *trip = [[TKTrip alloc] initFromDatabase:tripDict dayDicts:dayDicts dayItemDicts:dayItemDicts];
+		NSMutableDictionary<NSNumber *, NSString *> *tripNotes = notes[dayTripID];
+		if (!tripNotes) notes[dayTripID] = tripNotes = [NSMutableDictionary dictionaryWithCapacity:4];
 
-	// ...or Trip is not valid, return nil
-	if (!trip) return nil;
+		tripNotes[@([row integerAtIndex:1])] = [row stringAtIndex:2];
+	}];
 
-	// Return object
-	return trip;
-}
+	// Day items, rows come grouped by Trip and Day
+	NSMutableDictionary<NSString *, NSMutableDictionary<NSNumber *, NSMutableArray<TKTripDayItem *> *> *> *items =
+		[NSMutableDictionary dictionaryWithCapacity:16];
 
-- (NSArray<TKTrip *> *)allTrips
-{
-	NSMutableArray<TKTrip *> *trips = [NSMutableArray arrayWithCapacity:10];
+	__block NSString *currentTripID = nil;
+	__block long long currentDayIndex = -1;
+	__block NSMutableArray<TKTripDayItem *> *currentItems = nil;
 
-	NSArray *tripDicts = [_database runQuery:@"SELECT * FROM %@ "
-		"ORDER BY updated_at DESC;" tableName:kTKDatabaseTableTrips];
+	[_database enumerateQuery:(tripID) ?
+		@"SELECT * FROM %@ WHERE trip_id = ? ORDER BY day_index ASC, item_index ASC;" :
+		@"SELECT * FROM %@ ORDER BY trip_id ASC, day_index ASC, item_index ASC;"
+	  tableName:kTKDatabaseTableTripDayItems data:data usingBlock:^(TKDatabaseRow *row) {
 
-	if (!tripDicts.count) return @[ ];
+		NSString *itemTripID = [row stringForColumn:@"trip_id"];
+		long long dayIndex = [row integerForColumn:@"day_index"];
+		if (!itemTripID) return;
 
-	NSArray *tripIDs = [tripDicts mappedArrayUsingBlock:^id(NSDictionary *dict) {
-		return [dict[@"id"] parsedString];
-	}];
+		TKTripDayItem *item = [[TKTripDayItem alloc] initFromDatabaseRow:row];
+		if (!item) return;
 
-	NSString *tripsStr = [NSString stringWithFormat:@"'%@'", [tripIDs componentsJoinedByString:@"','"]];
+		if (dayIndex != currentDayIndex || ![itemTripID isEqualToString:currentTripID])
+		{
+			NSMutableDictionary<NSNumber *, NSMutableArray<TKTripDayItem *> *> *tripItems = items[itemTripID];
+			if (!tripItems) items[itemTripID] = tripItems = [NSMutableDictionary dictionaryWithCapacity:4];
 
-	NSArray *dayDicts = [_database runQuery:[NSString
-	  stringWithFormat:@"SELECT * FROM %@ WHERE trip_id IN (%@) "
-	    "ORDER BY day_index ASC;", kTKDatabaseTableTripDays, tripsStr]];
+			currentTripID = itemTripID;
+			currentDayIndex = dayIndex;
+			currentItems = [NSMutableArray arrayWithCapacity:8];
+			tripItems[@(dayIndex)] = currentItems;
+		}
 
-	NSArray *itemDicts = [_database runQuery:[NSString
-	  stringWithFormat:@"SELECT * FROM %@ WHERE trip_id IN (%@) "
-	    "ORDER BY day_index ASC, item_index ASC;", kTKDatabaseTableTripDayItems, tripsStr]];
+		[currentItems addObject:item];
+	}];
 
-	for (NSDictionary *tripDict in tripDicts)
-	{
-		NSString *tripID = [tripDict[@"id"] parsedString];
+	// Compose the Days
+	NSMutableSet<NSString *> *tripIDs = [NSMutableSet setWithArray:notes.allKeys];
+	[tripIDs addObjectsFromArray:items.allKeys];
 
-		if (!tripID) continue;
+	NSMutableDictionary<NSString *, NSDictionary<NSNumber *, TKTripDay *> *> *days =
+		[NSMutableDictionary dictionaryWithCapacity:tripIDs.count];
 
-		NSArray *tripDayDicts = [dayDicts filteredArrayUsingBlock:^BOOL(NSDictionary *dayDict) {
-			return [[dayDict[@"trip_id"] parsedString] isEqualToString:tripID];
-		}];
+	for (NSString *dayTripID in tripIDs)
+	{
+		NSDictionary<NSNumber *, NSString *> *tripNotes = notes[dayTripID];
+		NSDictionary<NSNumber *, NSArray<TKTripDayItem *> *> *tripItems = items[dayTripID];
 
-		NSArray *tripItemDicts = [itemDicts filteredArrayUsingBlock:^BOOL(NSDictionary *itemDict) {
-			return [[itemDict[@"trip_id"] parsedString] isEqualToString:tripID];
-		}];
+		NSMutableSet<NSNumber *> *dayIndexes = [NSMutableSet setWithArray:tripNotes.allKeys];
+		[dayIndexes addObjectsFromArray:tripItems.allKeys];
 
-		TKTrip *trip = [[TKTrip alloc] initFromDatabase:tripDict
-			dayDicts:tripDayDicts dayItemDicts:tripItemDicts];
+		NSMutableDictionary<NSNumber *, TKTripDay *> *tripDays =
+			[NSMutableDictionary dictionaryWithCapacity:dayIndexes.count];
 
-		if (!trip) continue;
+		for (NSNumber *dayIndex in dayIndexes)
+			tripDays[dayIndex] = [[TKTripDay alloc] initWithNote:tripNotes[dayIndex]
+				items:tripItems[dayIndex] ?: @[ ]];
 
-		[trips addObject:trip];
+		days[dayTripID] = tripDays;
 	}
 
-	return trips;
+	return days;
 }
 
-- (TKTripInfo *)infoForTripWithID:(NSString *)tripID
+- (TKTrip *)tripWithID:(NSString *)tripID
 {
 	if (!tripID) return nil;
 
-	NSDictionary *result = [[_database runQuery:@"SELECT * FROM %@ WHERE id = ? LIMIT 1;"
-									  tableName:kTKDatabaseTableTrips data:@[ tripID ]] lastObject];
+	NSDictionary<NSNumber *, TKTripDay *> *days = [self storedDaysOfTripWithID:tripID][tripID] ?: @{ };
+
+	// Return object, nil if there's no valid Trip
+	return [[_database runQuery:@"SELECT * FROM %@ WHERE id = ? LIMIT 1;" tableName:kTKDatabaseTableTrips
+	  data:@[ tripID ] decoder:^id(TKDatabaseRow *row) {
+		return [[TKTrip alloc] initFromDatabaseRow:row days:days];
+	}] firstObject];
+}
+
+- (NSArray<TKTrip *> *)allTrips
+{
+	NSDictionary<NSString *, NSDictionary<NSNumber *, TKTripDay *> *> *days =
+		[self storedDaysOfTripWithID:nil];
 
-	// If there were no results...
-	if (!result) return nil;
+	return [_database runQuery:@"SELECT * FROM %@ ORDER BY updated_at DESC;"
+	  tableName:kTKDatabaseTableTrips data:nil decoder:^id(TKDatabaseRow *row) {
 
-	// Return object
-	return [[TKTripInfo alloc] initFromDatabase:result];
+		NSString *tripID = [row stringForColumn:@"id"];
+		if (!tripID) return nil;
+
+		return [[TKTrip alloc] initFromDatabaseRow:row days:days[tripID] ?: @{ }];
+	}];
 }
 
-- (BOOL)insertTrip:(TKTrip *)trip
+- (TKTripInfo *)infoForTripWithID:(NSString *)tripID
 {
-	NSString *tripID = trip.ID;
+	if (!tripID) return nil;
 
-	if (!tripID) return NO;
+	return [[self tripInfosForQuery:@"SELECT * FROM %@ WHERE id = ? LIMIT 1;"
+		data:@[ tripID ]] firstObject];
+}
 
-	id tripName = trip.name ?: [NSNull null];
+- (NSArray *)databaseValuesOfTrip:(TKTrip *)trip
+{
 	id startDate = [trip.startDate dateString] ?: [NSNull null];
 
 	NSDate *date = trip.lastUpdate;
@@ -163,58 +276,162 @@
 	id ownerID = trip.ownerID ?: [NSNull null];
 	id destinationIDs = [trip.destinationIDs componentsJoinedByString:@"|"] ?: [NSNull null];
 
-	BOOL ok = YES;
+	id endDate = TKTripsManagerEndsOn(trip.startDate, trip.days.count);
 
-	ok &= [_database runUpdate:@"INSERT INTO %@ (id, name, version, days, destination_ids, "
-		"owner_id, starts_on, updated_at, changed, deleted, privacy, rights) VALUES "
-		"(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);" tableName:kTKDatabaseTableTrips data:@[
-			tripID, tripName, @(trip.version), @(trip.days.count), destinationIDs, ownerID,
-			startDate, lastUpdate, @(trip.changed), @(trip.deleted), @(trip.privacy),
-			@(trip.rights)
-		]];
+	return @[ trip.ID, trip.name ?: [NSNull null], @(trip.version), @(trip.days.count),
+		destinationIDs, ownerID, startDate, endDate, lastUpdate, @(trip.changed), @(trip.deleted),
+		@(trip.privacy), @(trip.rights) ];
+}
+
+- (NSArray *)databaseValuesOfItem:(TKTripDayItem *)item
+	tripID:(NSString *)tripID dayIndex:(NSUInteger)dayIndex itemIndex:(NSUInteger)itemIndex
+{
+	id itemID = item.placeID ?: [NSNull null];
+	id startTime = item.startTime ?: [NSNull null];
+	id duration = item.duration ?: [NSNull null];
+	id itemNote = item.note ?: [NSNull null];
+
+	id transMode = @(item.transportMode);
+	id transAvoid = @(item.transportAvoid);
+	id transStartTime = item.transportStartTime ?: [NSNull null];
+	id transDuration = item.transportDuration ?: [NSNull null];
+	id transNote = item.transportNote ?: [NSNull null];
+	id transRouteID = item.transportRouteID ?: [NSNull null];
+	id transPoly = item.transportPolyline ?: [NSNull null];
+
+	return @[ tripID, @(dayIndex), @(itemIndex), itemID,
+		startTime, duration, itemNote, transMode, transAvoid,
+		transStartTime, transDuration, transNote, transPoly, transRouteID ];
+}
+
+- (BOOL)insertRows:(NSArray<NSArray *> *)rows columns:(NSString *)columns
+	tableName:(NSString *)tableName transaction:(TKDatabaseTransaction *)transaction
+{
+	NSUInteger index = 0;
 
-	NSMutableArray *queries = [NSMutableArray arrayWithCapacity:5*trip.days.count];
-	NSMutableArray *data    = [NSMutableArray arrayWithCapacity:5*trip.days.count];
+	while (index < rows.count)
+	{
+		// Full chunks share a single statement, the remainder goes row by row
+		NSUInteger count = (rows.count - index >= kTKTripsManagerInsertRowsChunk) ?
+			kTKTripsManagerInsertRowsChunk : 1;
 
-	[trip.days enumerateObjectsUsingBlock:^(TKTripDay *day, NSUInteger dayIndex, BOOL *__unused s1) {
+		NSMutableArray *data = [NSMutableArray arrayWithCapacity:count * rows[index].count];
+		for (NSUInteger i = index; i < index + count; i++)
+			[data addObjectsFromArray:rows[i]];
 
-		id note = day.note ?: [NSNull null];
+		if (![transaction runUpdate:TKTripsManagerInsertQuery(columns, count)
+		  tableName:tableName data:data]) return NO;
 
-		if (day.note.length) {
-			[queries addObject:[NSString stringWithFormat:
-			   @"INSERT INTO %@ (trip_id, day_index, note) VALUES (?, ?, ?);", kTKDatabaseTableTripDays]];
-			[data addObject:@[ tripID, @(dayIndex), note ]];
+		index += count;
+	}
+
+	return YES;
+}
+
+- (BOOL)storeTrips:(NSArray<TKTrip *> *)trips
+{
+	// Last occurrence of each Trip wins
+	NSMutableSet<NSString *> *tripIDs = [NSMutableSet setWithCapacity:trips.count];
+	NSMutableArray<TKTrip *> *storedTrips = [NSMutableArray arrayWithCapacity:trips.count];
+
+	for (TKTrip *trip in trips.reverseObjectEnumerator)
+		if (trip.ID && ![tripIDs containsObject:trip.ID]) {
+			[tripIDs addObject:trip.ID];
+			[storedTrips insertObject:trip atIndex:0];
 		}
 
-		[day.items enumerateObjectsUsingBlock:^(TKTripDayItem *item, NSUInteger itemIndex, BOOL *__unused s2) {
-
-			id itemID = item.placeID ?: [NSNull null];
-			id startTime = item.startTime ?: [NSNull null];
-			id duration = item.duration ?: [NSNull null];
-			id itemNote = item.note ?: [NSNull null];
-
-			id transMode = @(item.transportMode);
-			id transAvoid = @(item.transportAvoid);
-			id transStartTime = item.transportStartTime ?: [NSNull null];
-			id transDuration = item.transportDuration ?: [NSNull null];
-			id transNote = item.transportNote ?: [NSNull null];
-			id transRouteID = item.transportRouteID ?: [NSNull null];
-			id transPoly = item.transportPolyline ?: [NSNull null];
-
-			[queries addObject:[NSString stringWithFormat:
-			   @"INSERT INTO %@ (trip_id, day_index, item_index, item_id, start_time, "
-			    "duration, note, transport_mode, transport_avoid, "
-				"transport_start_time, transport_duration, transport_note, transport_polyline, transport_route_id) "
-				"VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);", kTKDatabaseTableTripDayItems]];
-			[data addObject:@[ tripID, @(dayIndex), @(itemIndex), itemID,
-			   startTime, duration, itemNote, transMode, transAvoid,
-			   transStartTime, transDuration, transNote, transPoly, transRouteID ]];
-		}];
-	}];
+	if (!storedTrips.count) return YES;
 
-	ok &= [_database runUpdateTransactionWithQueries:queries dataArray:data];
+	return [_database runTransactionUsingBlock:^BOOL(TKDatabaseTransaction *transaction) {
 
-	return ok;
+		NSMutableArray<NSArray *> *tripRows = [NSMutableArray arrayWithCapacity:storedTrips.count];
+		NSMutableArray<NSArray *> *dayRows = [NSMutableArray arrayWithCapacity:8];
+		NSMutableArray<NSArray *> *itemRows = [NSMutableArray arrayWithCapacity:64];
+
+		for (TKTrip *trip in storedTrips)
+		{
+			NSString *tripID = trip.ID;
+			NSUInteger daysCount = trip.days.count;
+
+			[tripRows addObject:[self databaseValuesOfTrip:trip]];
+
+			// Currently stored Day notes and Day items
+
+			NSMutableDictionary<NSNumber *, NSString *> *storedNotes = [NSMutableDictionary dictionary];
+
+			[transaction enumerateQuery:@"SELECT day_index, note FROM %@ WHERE trip_id = ?;"
+			  tableName:kTKDatabaseTableTripDays data:@[ tripID ] usingBlock:^(TKDatabaseRow *row) {
+				storedNotes[@([row integerAtIndex:0])] = [row stringAtIndex:1] ?: @"";
+			}];
+
+			NSMutableDictionary<NSNumber *, NSMutableArray<NSArray *> *> *storedItems = [NSMutableDictionary dictionary];
+
+			[transaction enumerateQuery:@"SELECT " TRIP_DAY_ITEM_COLUMNS " FROM %@ WHERE trip_id = ? "
+			  "ORDER BY day_index ASC, item_index ASC;" tableName:kTKDatabaseTableTripDayItems
+			  data:@[ tripID ] usingBlock:^(TKDatabaseRow *row) {
+
+				NSNumber *dayIndex = @([row integerAtIndex:1]);
+				NSMutableArray<NSArray *> *dayItems = storedItems[dayIndex];
+				if (!dayItems) storedItems[dayIndex] = dayItems = [NSMutableArray arrayWithCapacity:8];
+
+				NSMutableArray *values = [NSMutableArray arrayWithCapacity:row.columnCount];
+				for (int i = 0; i < row.columnCount; i++)
+					[values addObject:[row valueAtIndex:i]];
+
+				// Keep the stored rows aligned with their item indexes
+				if ([row integerAtIndex:2] == (long long)dayItems.count)
+					[dayItems addObject:values];
+			}];
+
+			// Drop the Days not present anymore
+
+			BOOL ok = [transaction runUpdate:@"DELETE FROM %@ WHERE trip_id = ? AND day_index >= ?;"
+				tableName:kTKDatabaseTableTripDays data:@[ tripID, @(daysCount) ]];
+			ok &= [transaction runUpdate:@"DELETE FROM %@ WHERE trip_id = ? AND day_index >= ?;"
+				tableName:kTKDatabaseTableTripDayItems data:@[ tripID, @(daysCount) ]];
+
+			if (!ok) return NO;
+
+			// Diff the Days, only changed rows get written
+
+			for (NSUInteger dayIndex = 0; dayIndex < daysCount; dayIndex++)
+			{
+				TKTripDay *day = trip.days[dayIndex];
+				NSString *storedNote = storedNotes[@(dayIndex)];
+
+				if (day.note.length) {
+					if (![storedNote isEqualToString:day.note])
+						[dayRows addObject:@[ tripID, @(dayIndex), day.note ]];
+				}
+				else if (storedNote && ![transaction runUpdate:@"DELETE FROM %@ WHERE trip_id = ? AND day_index = ?;"
+				  tableName:kTKDatabaseTableTripDays data:@[ tripID, @(dayIndex) ]]) return NO;
+
+				NSArray<NSArray *> *dayStoredItems = storedItems[@(dayIndex)];
+				NSArray<TKTripDayItem *> *items = day.items;
+
+				[items enumerateObjectsUsingBlock:^(TKTripDayItem *item, NSUInteger itemIndex, BOOL *__unused stop) {
+
+					NSArray *values = [self databaseValuesOfItem:item
+						tripID:tripID dayIndex:dayIndex itemIndex:itemIndex];
+
+					if (itemIndex >= dayStoredItems.count || ![dayStoredItems[itemIndex] isEqualToArray:values])
+						[itemRows addObject:values];
+				}];
+
+				if (dayStoredItems.count > items.count &&
+				    ![transaction runUpdate:@"DELETE FROM %@ WHERE trip_id = ? AND day_index = ? AND item_index >= ?;"
+				      tableName:kTKDatabaseTableTripDayItems data:@[ tripID, @(dayIndex), @(items.count) ]])
+					return NO;
+			}
+		}
+
+		return [self insertRows:tripRows columns:@TRIP_COLUMNS
+				tableName:kTKDatabaseTableTrips transaction:transaction] &&
+			[self insertRows:dayRows columns:@TRIP_DAY_COLUMNS
+				tableName:kTKDatabaseTableTripDays transaction:transaction] &&
+			[self insertRows:itemRows columns:@TRIP_DAY_ITEM_COLUMNS
+				tableName:kTKDatabaseTableTripDayItems transaction:transaction];
+	}];
 }
 
 - (BOOL)saveTrip:(TKTrip *)trip
@@ -227,8 +444,7 @@
 
 - (BOOL)storeTrip:(TKTrip *)trip
 {
-	[self deleteTripWithID:trip.ID];
-	return [self insertTrip:trip];
+	return [self storeTrips:@[ trip ]];
 }
 
 - (BOOL)deleteTripWithID:(NSString *)tripID
@@ -268,21 +484,63 @@
 }
 
 
-#pragma mark - Trip Info methods
+#pragma mark - Trip item occurrences
 
 
-- (NSArray<TKTripInfo *> *)allTripInfos
+- (NSDictionary<NSString *, NSArray<TKTripItemOccurrence *> *> *)occurrencesOfItemsWithIDs:(NSArray<NSString *> *)itemIDs
 {
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ "
-		"ORDER BY updated_at DESC;" tableName:kTKDatabaseTableTrips];
+	NSArray<NSString *> *uniqueIDs = [[NSOrderedSet orderedSetWithArray:itemIDs] array];
 
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
+	NSMutableDictionary<NSString *, NSMutableArray<TKTripItemOccurrence *> *> *occurrences =
+		[NSMutableDictionary dictionaryWithCapacity:uniqueIDs.count];
+
+	for (NSUInteger i = 0; i < uniqueIDs.count; i += kTKTripsManagerOccurrencesChunk)
+	{
+		NSArray<NSString *> *chunk = [uniqueIDs subarrayWithRange:
+			NSMakeRange(i, MIN(kTKTripsManagerOccurrencesChunk, uniqueIDs.count - i))];
+
+		NSUInteger placeholdersCount = 8;
+		while (placeholdersCount < chunk.count) placeholdersCount *= 2;
+
+		NSMutableArray *data = [chunk mutableCopy];
+		while (data.count < placeholdersCount) [data addObject:[NSNull null]];
+
+		[_database enumerateQuery:TKTripsManagerOccurrencesQuery(placeholdersCount)
+		  tableName:kTKDatabaseTableTripDayItems data:data usingBlock:^(TKDatabaseRow *row) {
+
+			long long dayIndex = [row integerAtIndex:2];
+			long long itemIndex = [row integerAtIndex:3];
+			if (dayIndex < 0 || itemIndex < 0) return;
+
+			TKTripItemOccurrence *occurrence = [[TKTripItemOccurrence alloc]
+				initWithItemID:[row stringAtIndex:0] tripID:[row stringAtIndex:1]
+				dayIndex:(NSUInteger)dayIndex itemIndex:(NSUInteger)itemIndex];
+			if (!occurrence) return;
+
+			NSMutableArray<TKTripItemOccurrence *> *itemOccurrences = occurrences[occurrence.itemID];
+			if (!itemOccurrences) occurrences[occurrence.itemID] = itemOccurrences = [NSMutableArray arrayWithCapacity:2];
+
+			[itemOccurrences addObject:occurrence];
+		}];
 	}
 
-	return trips;
+	return occurrences;
+}
+
+
+#pragma mark - Trip Info methods
+
+
+- (NSArray<TKTripInfo *> *)tripInfosForQuery:(NSString *)query data:(NSArray *)data
+{
+	return [_database runQuery:query tableName:kTKDatabaseTableTrips data:data decoder:^id(TKDatabaseRow *row) {
+		return [[TKTripInfo alloc] initFromDatabaseRow:row];
+	}];
+}
+
+- (NSArray<TKTripInfo *> *)allTripInfos
+{
+	return [self tripInfosForQuery:@"SELECT * FROM %@ ORDER BY updated_at DESC;" data:nil];
 }
 
 - (NSArray<TKTripInfo *> *)upcomingTripInfos
@@ -293,17 +551,9 @@
 
 	if (!upcomingString.length) return @[ ];
 
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE "
-						"(deleted != 1 OR deleted IS NULL) AND starts_on >= ? ORDER by starts_on ASC"
-								 tableName:kTKDatabaseTableTrips data:@[ upcomingString ]];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE "
+		"deleted = 0 AND starts_on >= ? ORDER BY starts_on ASC"
+		data:@[ upcomingString ]];
 }
 
 - (NSArray<TKTripInfo *> *)pastTripInfos
@@ -314,152 +564,93 @@
 
 	if (!pastString.length) return @[ ];
 
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE "
-						"(deleted != 1 OR deleted IS NULL) AND starts_on < ? ORDER by starts_on DESC"
-								 tableName:kTKDatabaseTableTrips data:@[ pastString ]];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE "
+		"deleted = 0 AND starts_on < ? ORDER BY starts_on DESC"
+		data:@[ pastString ]];
 }
 
 - (NSArray<TKTripInfo *> *)futureTripInfos
 {
 	// Get Trips starting not before tomorrow /* modified at least 2 days before start */
 
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE "
-		"(deleted != 1 OR deleted IS NULL) AND strftime('%Y-%m-%d',starts_on) > "
-		"DATE('now','start of day','+30 minutes') "
-		/* AND strftime('%Y-%m-%d',starts_on) >= DATE(strftime('%Y-%m-%d',updated_at),'+2 days') */
-		" ORDER BY updated_at DESC" tableName:kTKDatabaseTableTrips];
+	NSString *todayString = [[[NSDate now] midnight] dateString];
 
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
+	if (!todayString.length) return @[ ];
 
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE "
+		"deleted = 0 AND starts_on > ? "
+		/* AND starts_on >= DATE(updated_at, '+2 days') */
+		"ORDER BY updated_at DESC" data:@[ todayString ]];
 }
 
 - (NSArray<TKTripInfo *> *)tripInfosInYear:(NSInteger)year
 {
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE starts_on LIKE ? AND "
-		"(deleted != 1 OR deleted IS NULL) ORDER BY updated_at DESC" tableName:kTKDatabaseTableTrips
-			data:@[ [NSString stringWithFormat:@"%ld%%", (long)year] ]];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	// Range of the year keeps the lookup on the index
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE deleted = 0 AND "
+		"starts_on >= ? AND starts_on < ? ORDER BY updated_at DESC" data:@[
+			[NSString stringWithFormat:@"%04ld-01-01", (long)year],
+			[NSString stringWithFormat:@"%04ld-01-01", (long)year + 1] ]];
 }
 
 - (NSArray<TKTripInfo *> *)unscheduledTripInfos
 {
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE starts_on IS NULL AND "
-		"(deleted != 1 OR deleted IS NULL) ORDER BY updated_at DESC" tableName:kTKDatabaseTableTrips];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE deleted = 0 AND "
+		"starts_on IS NULL ORDER BY updated_at DESC" data:nil];
 }
 
 - (NSArray<TKTripInfo *> *)deletedTripInfos
 {
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE "
-		"deleted = 1 ORDER BY updated_at DESC" tableName:kTKDatabaseTableTrips];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE "
+		"deleted = 1 ORDER BY updated_at DESC" data:nil];
 }
 
 - (NSArray<TKTripInfo *> *)changedTripInfos
 {
-	NSArray *results = [_database runQuery:@"SELECT * FROM %@ WHERE "
-		"changed = 1 ORDER BY updated_at DESC" tableName:kTKDatabaseTableTrips];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:@"SELECT * FROM %@ WHERE "
+		"changed = 1 ORDER BY updated_at DESC" data:nil];
 }
 
 - (NSArray<TKTripInfo *> *)tripInfosForStartDate:(NSDate *)startDate
 	endDate:(NSDate *)endDate includeOverlapping:(BOOL)includeOverlapping
 {
-	NSMutableArray<NSString *> *whereClauses = [NSMutableArray arrayWithCapacity:8];
+	NSMutableArray<NSString *> *whereClauses = [NSMutableArray arrayWithCapacity:2];
+	NSMutableArray<NSString *> *data = [NSMutableArray arrayWithCapacity:2];
+
+	// Compare the stored dates directly so the indexes apply
 
 	if (startDate)
 	{
-		NSString *startFormat = [[NSDateFormatter sharedDateFormatter] stringFromDate:startDate];
-
-		if (includeOverlapping)
-			[whereClauses addObject:[NSString stringWithFormat:
-				@"DATE(starts_on,'+' || (days-1) || ' days', 'midnight') >= DATE(%@, 'midnight')", startFormat]];
-		else
-			[whereClauses addObject:[NSString stringWithFormat:
-				@"DATE(starts_on, 'midnight') >= DATE(%@, 'midnight')", startFormat]];
+		[whereClauses addObject:(includeOverlapping) ? @"ends_on >= ?" : @"starts_on >= ?"];
+		[data addObject:[startDate dateString] ?: @""];
 	}
 
 	if (endDate)
 	{
 		NSDate *realEndDate = [endDate dateByAddingNumberOfDays:1];
-		NSString *endFormat = [[NSDateFormatter sharedDateFormatter] stringFromDate:realEndDate];
-
-		if (includeOverlapping)
-			[whereClauses addObject:[NSString stringWithFormat:
-				@"DATE(starts_on, 'midnight') <= DATE(%@, 'midnight')", endFormat]];
-		else
-			[whereClauses addObject:[NSString stringWithFormat:
-				@"DATE(starts_on,'+' || (days-1) || ' days', 'midnight') < DATE(%@, 'midnight')", endFormat]];
+
+		[whereClauses addObject:(includeOverlapping) ? @"starts_on < ?" : @"ends_on < ?"];
+		[data addObject:[realEndDate dateString] ?: @""];
 	}
 
 	// Build an SQL query
 
-	NSString *query = [NSString stringWithFormat:@"SELECT * FROM %@", kTKDatabaseTableTrips];
+	NSString *query = @"SELECT * FROM %@";
 
 	if (whereClauses.count)
-		query = [query stringByAppendingFormat:@" WHERE (%@)",
+		query = [query stringByAppendingFormat:@" WHERE %@",
 			[whereClauses componentsJoinedByString:@" AND "]];
 
 	query = [query stringByAppendingString:@" ORDER BY starts_on ASC;"];
 
 	// Fetch results and process
 
-	NSArray *results = [_database runQuery:query];
-
-	NSMutableArray *trips = [NSMutableArray arrayWithCapacity:results.count];
-	for (NSDictionary *row in results) {
-		TKTripInfo *trip = [[TKTripInfo alloc] initFromDatabase:row];
-		if (trip) [trips addObject:trip];
-	}
-
-	return trips;
+	return [self tripInfosForQuery:query data:data];
 }
 
 - (NSArray<NSNumber *> *)yearsOfActiveTrips
 {
 	NSArray *results = [_database runQuery:@"SELECT DISTINCT SUBSTR(starts_on,1,4) year FROM %@ "
-		"WHERE starts_on NOT NULL AND (deleted != 1 OR deleted IS NULL) "
+		"WHERE deleted = 0 AND starts_on NOT NULL "
 		"ORDER BY year DESC;" tableName:kTKDatabaseTableTrips];
 
 	NSMutableArray<NSNumber *> *years = [NSMutableArray arrayWithCapacity:results.count];
@@ -485,6 +676,7 @@
 	id tripOwnerID = trip.ownerID ?: [NSNull null];
 
 	id tripDateStart = [trip.startDate dateString] ?: [NSNull null];
+	id tripDateEnd = TKTripsManagerEndsOn(trip.startDate, trip.daysCount);
 	id tripLastUpdate = [[NSDate now] a8601DateTimeString] ?: [NSNull null];
 	id tripChanged = @(trip.changed);
 	id tripDeleted = @(trip.deleted);
@@ -495,15 +687,15 @@
 
 	if (!local)
 		[_database runUpdate:@"INSERT INTO %@ (id, name, version, days, destination_ids, owner_id, starts_on, "
-		 "updated_at, changed, deleted, privacy, rights) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+		 "ends_on, updated_at, changed, deleted, privacy, rights) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
 			tableName:kTKDatabaseTableTrips data:@[ tripID, tripName, tripVersion, tripDaysCount,
-				tripDestinations, tripOwnerID, tripDateStart, tripLastUpdate,
+				tripDestinations, tripOwnerID, tripDateStart, tripDateEnd, tripLastUpdate,
 				tripChanged, tripDeleted, tripPrivacy, tripRights]];
 	else
 		[_database runUpdate:@"UPDATE %@ SET name = ?, version = ?, days = ?, destination_ids = ?, "
-		 "owner_id = ?, starts_on = ?, updated_at = ?, changed = ?, deleted = ?, privacy = ?, "
+		 "owner_id = ?, starts_on = ?, ends_on = ?, updated_at = ?, changed = ?, deleted = ?, privacy = ?, "
 		 "rights = ? WHERE id = ?;" tableName:kTKDatabaseTableTrips data:@[ tripName, tripVersion,
-			tripDaysCount, tripDestinations, tripOwnerID, tripDateStart, tripLastUpdate,
+			tripDaysCount, tripDestinations, tripOwnerID, tripDateStart, tripDateEnd, tripLastUpdate,
 			tripChanged, tripDeleted, tripPrivacy, tripRights, tripID ]];
 }
 
@@ -151,6 +151,14 @@ kit.places.detailedPlace(withID: "poi:530") { (place, e) in
  */
 @property (nonatomic, copy, null_resettable) NSString *languageID;
 
+/**
+ Whether large request bodies, such as Trip uploads, may be sent gzip-encoded.
+
+ Requests refused by the server for their encoding are sent once more uncompressed.
+ Default value is `YES`.
+ */
+@property (nonatomic) BOOL compressesRequestBodies;
+
 ///---------------------------------------------------------------------------------------
 /// @name Modules
 ///---------------------------------------------------------------------------------------
@@ -92,6 +92,16 @@
 	[TKAPI sharedAPI].languageID = newLanguageID;
 }
 
+- (BOOL)compressesRequestBodies
+{
+	return [TKAPI sharedAPI].compressesRequestBodies;
+}
+
+- (void)setCompressesRequestBodies:(BOOL)compressesRequestBodies
+{
+	[TKAPI sharedAPI].compressesRequestBodies = compressesRequestBodies;
+}
+
 
 #pragma mark -
 #pragma mark Generic methods